@@ -0,0 +1,799 @@
+// Unit checks and microbenchmarks for shorts_core. Runs headless in milliseconds;
+// exits non-zero if any check fails.
+
+#include "core/bulkedit.h"
+#include "core/directorystore.h"
+#include "core/fileclassifier.h"
+#include "core/fileutil.h"
+#include "core/functionlibrary.h"
+#include "core/healthcheck.h"
+#include "core/historypack.h"
+#include "core/memorystore.h"
+#include "core/overlaystore.h"
+#include "core/prefetcher.h"
+#include "core/scriptgenerator.h"
+#include "core/shortcutgraph.h"
+#include "core/shortcutparser.h"
+#include "core/shortcutstore.h"
+#include "core/threadpool.h"
+#include "core/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n",               \
+                         __FILE__, __LINE__, #cond);                        \
+            ++failures;                                                     \
+        }                                                                   \
+    } while (0)
+
+template <typename Fn>
+static void bench(const char *name, int iterations, Fn &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::printf("%-28s %10.1f ns/op\n", name, static_cast<double>(elapsed) / iterations);
+}
+
+// A fresh directory under /tmp, removed with everything in it at the end of the
+// check that made it
+class TempDir
+{
+public:
+    TempDir()
+    {
+        char dirTemplate[] = "/tmp/shorts_core_bench_XXXXXX";
+        if (::mkdtemp(dirTemplate)) {
+            m_path = dirTemplate;
+        }
+    }
+
+    ~TempDir()
+    {
+        if (!m_path.empty()) {
+            ::nftw(m_path.c_str(), [](const char *path, const struct stat *, int, struct FTW *) {
+                return ::remove(path);
+            }, 16, FTW_DEPTH | FTW_PHYS);
+        }
+    }
+
+    TempDir(const TempDir &) = delete;
+    TempDir &operator=(const TempDir &) = delete;
+
+    bool valid() const { return !m_path.empty(); }
+    const std::string &path() const { return m_path; }
+
+private:
+    std::string m_path;
+};
+
+static void checkNames()
+{
+    CHECK(ShortcutParser::isValidName("deploy"));
+    CHECK(ShortcutParser::isValidName("git-pull_2"));
+    CHECK(!ShortcutParser::isValidName(""));
+    CHECK(!ShortcutParser::isValidName(".."));
+    CHECK(!ShortcutParser::isValidName("a b"));
+    CHECK(!ShortcutParser::isValidName("../etc"));
+}
+
+static void checkRoundTrip()
+{
+    for (int mask = 0; mask < 8; ++mask) {
+        CommandOptions options;
+        options.useSudo = mask & 1;
+        options.runInBackground = mask & 2;
+        options.openEnded = mask & 4;
+
+        std::string script = ScriptGenerator::script("ls -la /tmp", options);
+        CHECK(script.rfind("#!/bin/bash\n# Shortcut created with Shorts", 0) == 0);
+
+        // Editing and saving unchanged writes the same script back
+        Shortcut parsed = ShortcutParser::parse(script);
+        CHECK(parsed.command == "ls -la /tmp");
+        CHECK(ScriptGenerator::script(parsed.command, parsed.options) == script);
+        CHECK(parsed.options.useSudo == options.useSudo);
+        CHECK(parsed.options.runInBackground == options.runInBackground);
+        CHECK(parsed.options.openEnded == options.openEnded);
+    }
+
+    CHECK(ShortcutParser::parse("#!/bin/bash\n# only comments\n\n").command.empty());
+    CHECK(ShortcutParser::parse("echo hi\r\n").command == "echo hi");
+}
+
+static void checkPreview()
+{
+    CommandOptions options;
+    CHECK(ScriptGenerator::preview("  ", options).empty());
+    CHECK(ScriptGenerator::preview("sudo apt update", options) == "sudo apt update");
+
+    options.runInBackground = true;
+    options.openEnded = true;
+    CHECK(ScriptGenerator::preview("htop", options) == "nohup htop $@ &");
+}
+
+static void checkStore()
+{
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+
+    DirectoryStore store(dir.path());
+    CHECK(store.available());
+    CHECK(store.list().empty());
+
+    std::string error;
+    CHECK(store.write("b", ScriptGenerator::script("true", CommandOptions()), &error));
+    CHECK(store.write("a", ScriptGenerator::script("false", CommandOptions()), &error));
+    CHECK(store.list() == (std::vector<std::string>{"a", "b"}));
+
+    std::string content;
+    CHECK(store.read("a", content));
+    CHECK(ShortcutParser::parse(content).command == "false");
+
+    // Small files are copied, so truncating one in place cannot fault a viewer;
+    // large ones are mapped
+    ShortcutStore::Contents contents;
+    CHECK(store.map("a", contents));
+    CHECK(::truncate(store.path("a").c_str(), 0) == 0);
+    CHECK(ShortcutParser::parse(std::string(contents.view())).command == "false");
+    const std::string large(DirectoryStore::MAP_THRESHOLD * 2, '#');
+    CHECK(store.write("a", large, &error));
+    CHECK(store.map("a", contents) && contents.view() == large);
+
+    CHECK(store.remove("a", &error));
+    CHECK(store.remove("b", &error));
+    CHECK(!store.exists("a"));
+    CHECK(!store.remove("a", &error));
+}
+
+static void checkClassifier()
+{
+    using Kind = FileClassifier::Kind;
+    CHECK(FileClassifier::classify(std::string("\x7f" "ELF\x02\x01\x01", 7)) == Kind::Elf);
+    CHECK(FileClassifier::classify("#!/bin/sh\nexec foo\n") == Kind::Script);
+    CHECK(FileClassifier::classify(ScriptGenerator::script("ls", CommandOptions())) == Kind::Shortcut);
+    CHECK(FileClassifier::classify("") == Kind::Other);
+    CHECK(FileClassifier::classify("# Shortcut created with Shorts") == Kind::Other);
+
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+
+    // A large binary is classified from its header alone
+    DirectoryStore store(dir.path());
+    std::string binary("\x7f" "ELF", 4);
+    binary.resize(4 << 20, '\0');
+    std::string error;
+    CHECK(store.write("tool", binary, &error));
+    CHECK(store.write("hello", ScriptGenerator::script("echo hello", CommandOptions()), &error));
+
+    std::vector<ShortcutStore::Entry> entries = store.entries();
+    CHECK(entries.size() == 2);
+    if (entries.size() == 2) {
+        CHECK(entries[0].name == "hello" && entries[0].info.kind == Kind::Shortcut);
+        CHECK(entries[0].info.interpreter == "/bin/bash");
+        CHECK(entries[1].name == "tool" && entries[1].info.kind == Kind::Elf);
+        CHECK(entries[1].info.size == binary.size());
+    }
+
+    bench("DirectoryStore::entries", 1000, [&] {
+        volatile size_t n = store.entries().size();
+        (void)n;
+    });
+
+    CHECK(store.remove("tool", &error));
+    CHECK(store.remove("hello", &error));
+}
+
+static void checkBatch()
+{
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+
+    DirectoryStore store(dir.path());
+    std::string error;
+    CHECK(store.write("old", ScriptGenerator::script("true", CommandOptions()), &error));
+
+    std::vector<ShortcutStore::Operation> operations(3);
+    operations[0] = {ShortcutStore::Operation::Write, "a", ScriptGenerator::script("echo a", CommandOptions())};
+    operations[1] = {ShortcutStore::Operation::Write, "b", ScriptGenerator::script("echo b", CommandOptions())};
+    operations[2] = {ShortcutStore::Operation::Remove, "old", ""};
+    CHECK(store.applyBatch(operations, &error));
+    CHECK(store.list() == (std::vector<std::string>{"a", "b"}));
+
+    // A bad name anywhere rejects the whole batch before anything changes
+    operations[0].content = ScriptGenerator::script("echo changed", CommandOptions());
+    operations[1].name = "../escape";
+    operations.pop_back();
+    CHECK(!store.applyBatch(operations, &error));
+    std::string content;
+    CHECK(store.read("a", content));
+    CHECK(ShortcutParser::parse(content).command == "echo a");
+
+    CHECK(store.remove("a", &error));
+    CHECK(store.remove("b", &error));
+}
+
+static void checkBackends()
+{
+    // In memory: same contract, no file system
+    MemoryStore memory;
+    std::string error;
+    CHECK(memory.available() && memory.list().empty());
+    CHECK(memory.write("b", ScriptGenerator::script("true", CommandOptions()), &error));
+    CHECK(memory.write("a", "\x7f" "ELF", &error));
+    CHECK(memory.list() == (std::vector<std::string>{"a", "b"}));
+    std::vector<ShortcutStore::Entry> entries = memory.entries();
+    CHECK(entries.size() == 2 && entries[0].info.kind == FileClassifier::Kind::Elf);
+    CHECK(entries.size() == 2 && entries[1].info.kind == FileClassifier::Kind::Shortcut);
+    CHECK(!memory.write("../escape", "", &error));
+
+    // A view outlives the write that replaces its shortcut
+    ShortcutStore::Contents contents;
+    CHECK(memory.map("b", contents));
+    uint64_t version = memory.version();
+    CHECK(memory.write("b", ScriptGenerator::script("false", CommandOptions()), &error));
+    CHECK(memory.version() != version);
+    CHECK(ShortcutParser::parse(contents.view()).command == "true");
+    CHECK(memory.remove("a", &error) && !memory.exists("a") && !memory.remove("a", &error));
+
+    TempDir userDir;
+    TempDir systemDir;
+    if (!userDir.valid() || !systemDir.valid()) {
+        ++failures;
+        return;
+    }
+
+    // Mapped files behave the same way
+    DirectoryStore system(systemDir.path());
+    CHECK(system.write("shared", ScriptGenerator::script("echo system", CommandOptions()), &error));
+    CHECK(system.write("base", ScriptGenerator::script("ls", CommandOptions()), &error));
+    CHECK(system.map("shared", contents));
+    CHECK(system.write("shared", ScriptGenerator::script("echo replaced", CommandOptions()), &error));
+    CHECK(ShortcutParser::parse(contents.view()).command == "echo system");
+    CHECK(system.write("empty", "", &error));
+    CHECK(system.map("empty", contents) && contents.view().empty());
+    CHECK(system.remove("empty", &error));
+
+    // The user directory is created on the first write and shadows the system one
+    const std::string userDirectory = userDir.path() + "/bin";
+    OverlayStore overlay(userDirectory, systemDir.path());
+    CHECK(overlay.list() == (std::vector<std::string>{"base", "shared"}));
+    CHECK(overlay.isSystem("shared"));
+    CHECK(overlay.write("shared", ScriptGenerator::script("echo user", CommandOptions()), &error));
+    CHECK(overlay.write("mine", ScriptGenerator::script("pwd", CommandOptions()), &error));
+    CHECK(overlay.list() == (std::vector<std::string>{"base", "mine", "shared"}));
+    entries = overlay.entries();
+    CHECK(entries.size() == 3);
+    std::string content;
+    CHECK(overlay.read("shared", content) && ShortcutParser::parse(content).command == "echo user");
+    CHECK(overlay.path("shared") == userDirectory + "/shared");
+    CHECK(overlay.path("base") == systemDir.path() + "/base");
+
+    // Only user copies can go; removing one uncovers the system shortcut
+    CHECK(!overlay.remove("base", &error));
+    CHECK(overlay.exists("base"));
+    CHECK(overlay.remove("shared", &error));
+    CHECK(overlay.read("shared", content) && ShortcutParser::parse(content).command == "echo replaced");
+
+    bench("MemoryStore::map", 1000000, [&] {
+        memory.map("b", contents);
+    });
+    bench("DirectoryStore::map", 10000, [&] {
+        system.map("base", contents);
+    });
+
+    CHECK(overlay.remove("mine", &error));
+    CHECK(system.remove("shared", &error) && system.remove("base", &error));
+}
+
+static void checkBulkEdit()
+{
+    CHECK(ShortcutParser::stripOptions("nohup sudo htop $@ &") == "htop");
+    CHECK(ShortcutParser::stripOptions("make install \"$@\"") == "make install");
+    CHECK(ShortcutParser::stripOptions("echo sudo") == "echo sudo");
+
+    CommandOptions options;
+    options.runInBackground = true;
+    Shortcut shortcut = ShortcutParser::parse(ScriptGenerator::script("sync-photos", options));
+
+    CHECK(BulkEdit::hasFlag(shortcut, BulkEdit::Flag::Background));
+    CHECK(!BulkEdit::hasFlag(shortcut, BulkEdit::Flag::Sudo));
+
+    Shortcut elevated = BulkEdit::withFlag(shortcut, BulkEdit::Flag::Sudo, true);
+    CHECK(elevated.command == "sync-photos");
+    CHECK(elevated.options.useSudo && elevated.options.runInBackground);
+
+    Shortcut foreground = BulkEdit::withFlag(elevated, BulkEdit::Flag::Background, false);
+    CHECK(ScriptGenerator::commandLine(foreground.command, foreground.options) == "sudo sync-photos");
+
+    Shortcut replaced = BulkEdit::withReplacement(shortcut, "photos", "music");
+    CHECK(replaced.command == "sync-music");
+    CHECK(replaced.options.runInBackground);
+}
+
+static Shortcut shortcutOf(const std::string &name, const std::string &command)
+{
+    Shortcut shortcut;
+    shortcut.name = name;
+    shortcut.command = ShortcutParser::commandLine(ScriptGenerator::scriptForLine(command));
+    return shortcut;
+}
+
+static void checkGraph()
+{
+    ShortcutGraph graph;
+    graph.build({shortcutOf("deploy", "build && push"),
+                 shortcutOf("build", "make -j8 $@"),
+                 shortcutOf("push", "/usr/local/bin/upload origin"),
+                 shortcutOf("upload", "git push \"$@\""),
+                 shortcutOf("logs", "journalctl -f > /tmp/log"),
+                 shortcutOf("tail", "sudo logs"),
+                 shortcutOf("ping", "pong"),
+                 shortcutOf("pong", "ping")},
+                "/usr/local/bin");
+
+    CHECK(graph.callees("deploy") == (std::vector<std::string>{"build", "push"}));
+    CHECK(graph.callers("upload") == std::vector<std::string>{"push"});
+    CHECK(graph.dependents("upload") == (std::vector<std::string>{"push", "deploy"}));
+    CHECK(graph.longestChain("deploy") == (std::vector<std::string>{"deploy", "push", "upload"}));
+    CHECK(graph.cycles() == (std::vector<std::vector<std::string>>{{"ping", "pong"}}));
+    CHECK(graph.inCycle("ping") && !graph.inCycle("deploy"));
+
+    CHECK(ShortcutGraph::isTriviallyForwarding("sudo make -j8 \"$@\""));
+    CHECK(!ShortcutGraph::isTriviallyForwarding("make && make install"));
+    CHECK(!ShortcutGraph::isTriviallyForwarding("echo $1"));
+    CHECK(ShortcutGraph::isTriviallyForwarding("grep 'a && b' notes"));
+    CHECK(ShortcutGraph::isTriviallyForwarding("LANG=C nohup make"));
+    CHECK(!ShortcutGraph::isTriviallyForwarding("exec make"));
+    CHECK(!ShortcutGraph::isTriviallyForwarding("sudo exit 1"));
+    CHECK(!ShortcutGraph::isTriviallyForwarding("cd /srv"));
+    CHECK(!ShortcutGraph::isTriviallyForwarding("X=1"));
+
+    // Chains collapse into one command line; redirections and cycles block inlining
+    CHECK(graph.flatten("deploy") == "make -j8 && git push origin");
+    CHECK(graph.flatten("tail") == "sudo logs");
+    CHECK(graph.flatten("ping") == "pong");
+
+    std::string script = graph.script("deploy", true);
+    CHECK(ShortcutParser::parse(script).command == "build && push");
+    CHECK(script.find("\nmake -j8 && git push origin\n") != std::string::npos);
+    CHECK(graph.script("deploy", false) == ScriptGenerator::scriptForLine("build && push"));
+
+    graph.insert(shortcutOf("build", "ninja"));
+    CHECK(graph.flatten("deploy") == "ninja && git push origin");
+    graph.remove("build");
+    CHECK(graph.flatten("deploy") == "build && git push origin");
+
+    // A callee that runs a builtin stays a call: inlined, exec would end the
+    // caller before push and cd would move it
+    graph.insert(shortcutOf("build", "exec make"));
+    CHECK(graph.flatten("deploy") == "build && git push origin");
+    graph.insert(shortcutOf("build", "cd /srv"));
+    CHECK(graph.flatten("deploy") == "build && git push origin");
+}
+
+static void checkThreadPool()
+{
+    ThreadPool pool(4);
+    std::atomic<int> count{0};
+    for (int i = 0; i < 1000; ++i) {
+        pool.submit([&] {
+            // Work submitted from a worker lands on its own deque
+            pool.submit([&] { ++count; });
+            ++count;
+        });
+    }
+    pool.wait();
+    CHECK(count == 2000);
+}
+
+static void checkHealth()
+{
+    using Problem = HealthCheck::Problem;
+    auto problems = [](const std::string &line, const std::string &interpreter = std::string()) {
+        std::vector<Problem> result;
+        for (const HealthCheck::Finding &finding : HealthCheck::check("x", line, interpreter)) {
+            result.push_back(finding.problem);
+        }
+        return result;
+    };
+
+    CHECK(problems("ls -la /tmp").empty());
+    CHECK(problems("sudo -E nohup sh -c 'exit 0' > /tmp/out 2>&1 &").empty());
+    CHECK(problems("cd /tmp && echo \"$HOME\" | cat").empty());
+    CHECK(problems("/nonexistent/tool --flag") == std::vector<Problem>{Problem::Missing});
+    CHECK(problems("no-such-command-for-shorts") == std::vector<Problem>{Problem::Missing});
+    CHECK(problems("cat /nonexistent-dir/file") == std::vector<Problem>{Problem::Missing});
+    CHECK(problems("touch /tmp/not-created-yet").empty());
+    CHECK(problems("true", "/bin/no-such-shell") == std::vector<Problem>{Problem::BadInterpreter});
+    CHECK(problems("true", "/usr/bin/env no-such-interpreter") == std::vector<Problem>{Problem::BadInterpreter});
+    CHECK(problems("/tmp") == std::vector<Problem>{Problem::NotExecutable});
+
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+
+    // A stuck read is reported as a timeout without holding up the rest
+    auto store = std::make_shared<DirectoryStore>(dir.path());
+    std::vector<std::string> names;
+    std::string error;
+    for (int i = 0; i < 2000; ++i) {
+        std::string name = "s" + std::to_string(i);
+        CHECK(store->write(name, ScriptGenerator::script(i % 100 ? "ls /tmp" : "/gone/tool", CommandOptions()), &error));
+        names.push_back(name);
+    }
+    std::string fifo = store->path("stuck");
+    CHECK(::mkfifo(fifo.c_str(), 0755) == 0);
+    names.push_back("stuck");
+
+    auto health = std::make_unique<HealthCheck>(4);
+    std::atomic<size_t> progressed{0};
+    std::atomic<bool> returned{false};
+    std::atomic<int> late{0};
+    HealthCheck::Report report = health->run(store, names, 200, [&](size_t done, size_t) {
+        progressed = std::max(progressed.load(), done);
+        late += returned.load();
+    });
+    returned = true;
+
+    size_t missing = 0;
+    size_t timeouts = 0;
+    for (const HealthCheck::Finding &finding : report.findings) {
+        missing += finding.problem == Problem::Missing;
+        timeouts += finding.problem == Problem::Timeout && finding.name == "stuck";
+    }
+    CHECK(report.checked == names.size());
+    CHECK(missing == 20);
+    CHECK(timeouts == 1);
+    CHECK(progressed >= names.size() - 1);
+    std::printf("%-28s %10.1f ms for %zu shortcuts\n", "HealthCheck::run",
+                static_cast<double>(report.elapsedNs) / 1e6, names.size());
+
+    // The stuck worker does not shrink the next run, and once it gets through it
+    // reports no progress to the run that gave up on it
+    names.pop_back();
+    CHECK(health->run(store, names, 200).findings.size() == 20);
+    auto unblock = [](const std::string &path) {
+        int writer = ::open(path.c_str(), O_WRONLY | O_NONBLOCK);
+        if (writer >= 0) {
+            ::close(writer);
+        }
+    };
+    unblock(fifo);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(late == 0);
+
+    // Nor does a worker stuck for good block the destructor
+    std::string fifo2 = store->path("stuck2");
+    CHECK(::mkfifo(fifo2.c_str(), 0755) == 0);
+    CHECK(health->run(store, {"stuck2"}, 100).findings.size() == 1);
+    health.reset();
+    unblock(fifo2);
+}
+
+static void checkHistory()
+{
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+    const std::string packPath = dir.path() + "/history.pack";
+
+    std::vector<std::string> saved;
+    {
+        HistoryPack pack(packPath);
+        std::string error;
+        CHECK(pack.open(&error));
+
+        // Enough versions to cross several keyframes
+        for (int i = 0; i < 40; ++i) {
+            CommandOptions options;
+            options.openEnded = i % 3 == 0;
+            saved.push_back(ScriptGenerator::script("make -j" + std::to_string(i), options));
+            CHECK(pack.append("build", saved.back(), &error));
+        }
+        CHECK(pack.append("build", saved.back(), &error)); // unchanged: no new version
+        CHECK(pack.append("other", "echo other\n", &error));
+        CHECK(pack.versions("build").size() == saved.size());
+
+        // Storage grows with the edits, not with saves x script size
+        CHECK(pack.size() < saved.size() * saved.front().size() / 4);
+    }
+
+    HistoryPack pack(packPath);
+    CHECK(pack.open());
+    CHECK(pack.versions("build").size() == saved.size());
+    for (size_t i = 0; i < saved.size(); ++i) {
+        std::string content;
+        CHECK(pack.load("build", static_cast<uint32_t>(i), content));
+        CHECK(content == saved[i]);
+    }
+
+    std::string content;
+    CHECK(pack.compact(10));
+    CHECK(pack.versions("build").size() == 10);
+    CHECK(pack.load("build", 39, content) && content == saved[39]);
+    CHECK(pack.load("build", 30, content) && content == saved[30]);
+    CHECK(!pack.load("build", 29, content));
+    CHECK(pack.load("other", 0, content) && content == "echo other\n");
+
+    // A torn tail is dropped on open and appends continue cleanly
+    uint64_t size = pack.size();
+    pack.close();
+    {
+        FILE *f = std::fopen(packPath.c_str(), "ab");
+        std::fputs("SHRVgarbage", f);
+        std::fclose(f);
+    }
+    CHECK(pack.open());
+    CHECK(pack.size() == size);
+    CHECK(pack.append("build", "echo new\n"));
+    CHECK(pack.load("build", 40, content) && content == "echo new\n");
+
+    // A second writer on the same pack: appends interleave, and a compaction
+    // by one is followed by the other
+    {
+        HistoryPack second(packPath);
+        CHECK(second.open());
+        CHECK(second.append("build", "echo second\n"));
+        CHECK(pack.append("build", "echo third\n"));
+        CHECK(pack.load("build", 42, content) && content == "echo third\n");
+        CHECK(second.compact(5));
+        CHECK(pack.append("build", "echo fourth\n"));
+        CHECK(second.append("other", "echo other 2\n"));
+    }
+    pack.close();
+    CHECK(pack.open());
+    CHECK(pack.versions("build").size() == 6);
+    CHECK(pack.load("build", 41, content) && content == "echo second\n");
+    CHECK(pack.load("build", 43, content) && content == "echo fourth\n");
+    CHECK(pack.load("other", 1, content) && content == "echo other 2\n");
+
+    std::printf("%-28s %10llu bytes for %zu versions\n", "HistoryPack size",
+                static_cast<unsigned long long>(pack.size()), saved.size() + 2);
+
+    bench("HistoryPack::load", 10000, [&] {
+        std::string out;
+        pack.load("build", 38, out);
+    });
+
+    pack.close();
+}
+
+static void checkPrefetcher()
+{
+    ShortcutCache cache(2);
+    Shortcut a{"a", "echo a", CommandOptions()};
+    Shortcut b{"b", "echo b", CommandOptions()};
+    Shortcut c{"c", "echo c", CommandOptions()};
+    cache.insert(a, cache.generation());
+    cache.insert(b, cache.generation());
+
+    Shortcut out;
+    CHECK(cache.lookup("a", out) && out.command == "echo a"); // a is now most recent
+    cache.insert(c, cache.generation());
+    CHECK(!cache.contains("b"));
+    CHECK(cache.contains("a") && cache.contains("c"));
+
+    // Data loaded before an invalidation is not cached
+    uint64_t stale = cache.generation();
+    cache.invalidate("a");
+    cache.insert(a, stale);
+    CHECK(!cache.contains("a"));
+
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+
+    DirectoryStore store(dir.path());
+    std::vector<std::string> names;
+    for (int i = 0; i < 8; ++i) {
+        names.push_back("s" + std::to_string(i));
+        store.write(names.back(), ScriptGenerator::script("echo " + std::to_string(i), CommandOptions()));
+    }
+
+    {
+        Prefetcher prefetcher(store, 16);
+        prefetcher.prefetch(names);
+        for (int i = 0; i < 200 && prefetcher.stats().prefetched < names.size(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        Shortcut shortcut;
+        CHECK(prefetcher.get("s3", shortcut) && shortcut.command == "echo 3");
+        CHECK(prefetcher.stats().hits == 1);
+
+        prefetcher.invalidate("s3");
+        store.write("s3", ScriptGenerator::script("echo changed", CommandOptions()));
+        CHECK(prefetcher.get("s3", shortcut) && shortcut.command == "echo changed");
+        CHECK(prefetcher.stats().misses == 1);
+        CHECK(!prefetcher.get("missing", shortcut));
+
+        bench("Prefetcher::get (hit)", 100000, [&] {
+            prefetcher.get("s5", shortcut);
+        });
+    }
+}
+
+static void checkFunctionLibrary()
+{
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+    const std::string path = dir.path() + "/shorts.sh";
+
+    FunctionLibrary library(path);
+    CHECK(library.load());
+    CHECK(library.list().empty());
+
+    CommandOptions background;
+    background.runInBackground = true;
+    std::string error;
+    CHECK(library.upsert(Shortcut{"build", "make -j8", CommandOptions()}, &error));
+    CHECK(library.upsert(Shortcut{"serve", "python3 -m http.server", background}, &error));
+
+    // Editing one shortcut leaves the other blocks byte for byte
+    std::string before;
+    FileUtil::readFile(path, before);
+    CHECK(library.upsert(Shortcut{"build", "make -j16", CommandOptions()}, &error));
+    std::string after;
+    FileUtil::readFile(path, after);
+    const std::string serveBlock = FunctionLibrary::renderBlock(
+        Shortcut{"serve", "python3 -m http.server", background});
+    CHECK(before.find(serveBlock) != std::string::npos);
+    CHECK(after.find(serveBlock) != std::string::npos);
+
+    // Unparseable commands never reach the file
+    CHECK(!library.upsert(Shortcut{"broken", "echo 'unterminated", CommandOptions()}, &error));
+    CHECK(!library.contains("broken"));
+
+    FunctionLibrary reloaded(path);
+    CHECK(reloaded.load());
+    CHECK(reloaded.list() == (std::vector<std::string>{"build", "serve"}));
+    Shortcut shortcut;
+    CHECK(reloaded.get("build", shortcut) && shortcut.command == "make -j16");
+    CHECK(reloaded.get("serve", shortcut) && shortcut.options.runInBackground);
+    CHECK(shortcut.command == "python3 -m http.server");
+
+    // Saving a decorated function unchanged writes it back byte for byte
+    CommandOptions all;
+    all.useSudo = all.runInBackground = all.openEnded = true;
+    CHECK(reloaded.upsert(Shortcut{"serve", "python3 -m http.server", all}, &error));
+    std::string saved;
+    FileUtil::readFile(path, saved);
+    CHECK(reloaded.get("serve", shortcut) && reloaded.upsert(shortcut, &error));
+    FunctionLibrary again(path);
+    CHECK(again.load() && again.get("serve", shortcut) && again.upsert(shortcut, &error));
+    std::string resaved;
+    FileUtil::readFile(path, resaved);
+    CHECK(resaved == saved);
+    CHECK(shortcut.command == "python3 -m http.server" && shortcut.options.useSudo
+          && shortcut.options.runInBackground && shortcut.options.openEnded);
+
+    // A change made through another instance is picked up before writing
+    CHECK(reloaded.remove("build", &error));
+    CHECK(library.upsert(Shortcut{"test", "make test", CommandOptions()}, &error));
+    CHECK(library.list() == (std::vector<std::string>{"serve", "test"}));
+}
+
+// Runs last: once started, tracing stays on for the rest of the process
+static void checkTrace()
+{
+    TempDir dir;
+    if (!dir.valid()) {
+        ++failures;
+        return;
+    }
+    const std::string path = dir.path() + "/trace.json";
+
+    CHECK(Trace::outputPath().empty());
+    Trace::start(path);
+    CHECK(Trace::enabled() && Trace::outputPath() == path);
+    Trace::setThreadName("bench");
+    {
+        TRACE_SCOPE("outer");
+        ShortcutParser::parse(ScriptGenerator::script("echo \"quoted\"", CommandOptions()));
+    }
+    std::thread([] {
+        Trace::setThreadName("worker");
+        TRACE_SCOPE("worker span", "arg with \"quotes\"");
+    }).join();
+
+    bench("TraceSpan (enabled)", 100000, [] {
+        TRACE_SCOPE("bench span");
+    });
+
+    CHECK(Trace::write());
+    std::string json;
+    CHECK(FileUtil::readFile(path, json));
+    CHECK(json.find("\"traceEvents\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"outer\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"ShortcutParser::parse\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"ScriptGenerator::script\"") != std::string::npos);
+    CHECK(json.find("arg with \\\"quotes\\\"") != std::string::npos);
+    CHECK(json.find("\"thread_name\"") != std::string::npos);
+}
+
+int main()
+{
+    checkNames();
+    checkRoundTrip();
+    checkPreview();
+    checkStore();
+    checkClassifier();
+    checkBatch();
+    checkBackends();
+    checkBulkEdit();
+    checkGraph();
+    checkThreadPool();
+    checkHealth();
+    checkHistory();
+    checkPrefetcher();
+    checkFunctionLibrary();
+
+    CommandOptions options;
+    options.openEnded = true;
+    const std::string script = ScriptGenerator::script("rsync -av ~/src host:/dst", options);
+
+    bench("ScriptGenerator::script", 100000, [&] {
+        volatile size_t n = ScriptGenerator::script("rsync -av ~/src host:/dst", options).size();
+        (void)n;
+    });
+    bench("ShortcutParser::parse", 100000, [&] {
+        volatile size_t n = ShortcutParser::parse(script).command.size();
+        (void)n;
+    });
+    bench("ShortcutParser::isValidName", 1000000, [] {
+        volatile bool ok = ShortcutParser::isValidName("git-pull_2");
+        (void)ok;
+    });
+
+    bench("TraceSpan (disabled)", 10000000, [] {
+        TRACE_SCOPE("bench span");
+    });
+    const std::string spanArg = "a shortcut name too long for the small-string buffer";
+    bench("TraceSpan with arg (disabled)", 10000000, [&spanArg] {
+        TRACE_SCOPE("bench span", spanArg);
+    });
+    checkTrace();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
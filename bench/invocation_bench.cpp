@@ -0,0 +1,472 @@
+// Invocation latency of every shortcut style Shorts can generate. Each style is
+// written into a hermetic temporary directory, pointed at a no-op target and
+// executed many times; the report gives the fork/exec-to-exit latency
+// distribution and the CPU time and peak RSS per invocation, and can be recorded
+// as a baseline and compared against one.
+//
+//   shorts_invocation_bench [--iterations N] [--record FILE] [--baseline FILE]
+//                           [--tolerance PERCENT]
+//
+// Baselines are machine specific; record one before changing the generator and
+// compare on the same machine afterwards. Background styles are timed until
+// the script returns, not until the command it started exits.
+//
+// Peak RSS is the largest VmHWM of any process one invocation runs, read as
+// each exits from a few separate, traced runs. ru_maxrss would not do: a
+// spawned child inherits the harness's own high-water mark at exec.
+
+#include "core/fileutil.h"
+#include "core/functionlibrary.h"
+#include "core/scriptgenerator.h"
+#include "core/shortcutgraph.h"
+#include "core/shortcutparser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <spawn.h>
+#include <sstream>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Style {
+    std::string name;
+    std::vector<std::string> argv; // argv[0] is the program
+    int callsPerRun = 1;           // > 1 when one process makes many calls
+    std::string callLog{};         // where such a process logs each call's start and end
+};
+
+struct Result {
+    std::string style;
+    std::vector<double> latencyUs; // per call
+    double cpuUs = 0;              // user + system per call
+    long maxRssKib = 0;
+};
+
+double percentile(std::vector<double> sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+double timevalUs(const struct timeval &tv)
+{
+    return static_cast<double>(tv.tv_sec) * 1e6 + static_cast<double>(tv.tv_usec);
+}
+
+// Spawn argv with env and the standard streams on /dev/null, and wait for it;
+// the rusage covers the child and every descendant it waited for
+bool runOnce(const std::vector<std::string> &argv, char *const *env, double &latencyUs,
+             struct rusage &usage)
+{
+    static posix_spawn_file_actions_t *actions = [] {
+        static posix_spawn_file_actions_t quiet;
+        posix_spawn_file_actions_init(&quiet);
+        posix_spawn_file_actions_addopen(&quiet, 0, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&quiet, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&quiet, 2, "/dev/null", O_WRONLY, 0);
+        return &quiet;
+    }();
+
+    std::vector<char *> args;
+    for (const std::string &arg : argv) {
+        args.push_back(const_cast<char *>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = 0;
+    if (posix_spawn(&pid, args[0], actions, nullptr, args.data(), env) != 0) {
+        return false;
+    }
+    int status = 0;
+    while (::wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    latencyUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+long vmHwmKib(pid_t pid)
+{
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+// Run argv once under ptrace, following every process it starts, and return
+// the largest VmHWM any of them reached; 0 if it cannot be traced
+long peakRssKib(const std::vector<std::string> &argv, char *const *env)
+{
+    std::vector<char *> args;
+    for (const std::string &arg : argv) {
+        args.push_back(const_cast<char *>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        return 0;
+    }
+    if (pid == 0) {
+        int null = ::open("/dev/null", O_RDWR);
+        ::dup2(null, 0);
+        ::dup2(null, 1);
+        ::dup2(null, 2);
+        ::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        ::execve(args[0], args.data(), env);
+        ::_exit(127);
+    }
+
+    // The first stop is the exec; from then on every fork is followed and each
+    // process stops once more just before it exits, while its memory is still
+    // there to read
+    const long options = PTRACE_O_TRACEEXIT | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK
+                       | PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL;
+    bool started = false;
+    long peak = 0;
+    int status = 0;
+    pid_t stopped;
+    while ((stopped = ::waitpid(-1, &status, __WALL)) > 0 || errno == EINTR) {
+        if (stopped <= 0 || !WIFSTOPPED(status)) {
+            continue;
+        }
+        int signal = 0;
+        if (!started) {
+            ::ptrace(PTRACE_SETOPTIONS, stopped, nullptr, options);
+            started = true;
+        } else if (status >> 16 == PTRACE_EVENT_EXIT) {
+            peak = std::max(peak, vmHwmKib(stopped));
+        } else if (status >> 16 == 0 && WSTOPSIG(status) != SIGSTOP && WSTOPSIG(status) != SIGTRAP) {
+            signal = WSTOPSIG(status);
+        }
+        ::ptrace(PTRACE_CONT, stopped, nullptr, signal);
+    }
+    return peak;
+}
+
+// Per-call latencies a style logged as "start end" lines of $EPOCHREALTIME
+void readCallLog(const std::string &path, std::vector<double> &latencyUs)
+{
+    std::ifstream in(path);
+    double start, end;
+    while (in >> start >> end) {
+        latencyUs.push_back((end - start) * 1e6);
+    }
+}
+
+bool writeExecutable(const std::string &path, const std::string &content)
+{
+    std::string error;
+    if (!FileUtil::writeAtomic(path, content, 0755, &error)) {
+        std::fprintf(stderr, "Cannot write %s: %s\n", path.c_str(), error.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string findTrue()
+{
+    for (const char *candidate : {"/usr/bin/true", "/bin/true"}) {
+        if (::access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+    }
+    return std::string();
+}
+
+// The styles to measure, written into bin
+bool prepare(const std::string &root, std::vector<Style> &styles)
+{
+    const std::string bin = root + "/bin";
+    ::mkdir(bin.c_str(), 0755);
+    ::mkdir((root + "/home").c_str(), 0755);
+
+    // The no-op target, and a stand-in for sudo: a real sudo would prompt or need
+    // root, so the sudo style measures the extra exec it adds, not sudo's checks
+    std::string trueBinary = findTrue();
+    if (trueBinary.empty() || ::symlink(trueBinary.c_str(), (bin + "/noop").c_str()) != 0) {
+        std::fprintf(stderr, "No true(1) to use as the no-op target\n");
+        return false;
+    }
+    if (!writeExecutable(bin + "/sudo", "#!/bin/sh\nexec \"$@\"\n")) {
+        return false;
+    }
+
+    styles.push_back({"direct exec (floor)", {bin + "/noop"}});
+
+    // What onSaveClicked() writes, for each option on its own and all together
+    struct Variant {
+        const char *name;
+        bool sudo, background, openEnded;
+    };
+    const Variant variants[] = {
+        {"bash + banner", false, false, false},
+        {"nohup ... &", false, true, false},
+        {"sudo prefix", true, false, false},
+        {"$@", false, false, true},
+        {"sudo nohup ... $@ &", true, true, true},
+    };
+    int index = 0;
+    for (const Variant &variant : variants) {
+        CommandOptions options;
+        options.useSudo = variant.sudo;
+        options.runInBackground = variant.background;
+        options.openEnded = variant.openEnded;
+        std::string path = bin + "/style" + std::to_string(index++);
+        if (!writeExecutable(path, ScriptGenerator::script("noop", options))) {
+            return false;
+        }
+        Style style{variant.name, {path}};
+        if (variant.openEnded) {
+            style.argv.push_back("--flag");
+            style.argv.push_back("argument");
+        }
+        styles.push_back(style);
+    }
+
+    // A chain of three shortcuts, as generated and as flattened
+    ShortcutGraph graph;
+    std::vector<Shortcut> chain;
+    const char *const links[][2] = {{"c", "noop $@"}, {"b", "c $@"}, {"a", "b $@"}};
+    for (const auto &link : links) {
+        Shortcut shortcut;
+        shortcut.name = link[0];
+        shortcut.command = ShortcutParser::commandLine(ScriptGenerator::scriptForLine(link[1]));
+        chain.push_back(shortcut);
+    }
+    graph.build(chain, bin);
+    for (const Shortcut &shortcut : chain) {
+        if (!writeExecutable(bin + "/" + shortcut.name, graph.script(shortcut.name, false))) {
+            return false;
+        }
+    }
+    if (!writeExecutable(bin + "/a-flat", graph.script("a", true))) {
+        return false;
+    }
+    styles.push_back({"chain of 3", {bin + "/a"}});
+    styles.push_back({"chain of 3, flattened", {bin + "/a-flat"}});
+
+    // Function library: one shell sources it once and calls the function in a
+    // loop, which is how an interactive shell uses it. The shell times every
+    // call itself, so each call is a sample and its start-up is left out of the
+    // latencies; CPU time and RSS cover the whole run and are amortised over the
+    // calls in it
+    FunctionLibrary library(root + "/shorts.sh");
+    Shortcut function;
+    function.name = "fn";
+    function.command = "noop";
+    std::string error;
+    if (!library.upsert(function, &error)) {
+        std::fprintf(stderr, "Cannot write the function library: %s\n", error.c_str());
+        return false;
+    }
+    const int calls = 100;
+    const std::string callLog = root + "/calls";
+    std::string loop = ". " + FileUtil::shellQuote(library.path()) + "; exec 3>"
+                     + FileUtil::shellQuote(callLog) + "; i=0; while [ $i -lt " + std::to_string(calls)
+                     + " ]; do s=$EPOCHREALTIME; fn; e=$EPOCHREALTIME; echo \"$s $e\" >&3; i=$((i+1)); done";
+    styles.push_back({"function lib (amortised)", {"/bin/bash", "--noprofile", "--norc", "-c", loop}, calls,
+                      callLog});
+    return true;
+}
+
+Result measure(const Style &style, int iterations, char *const *env)
+{
+    Result result;
+    result.style = style.name;
+    const int runs = (iterations + style.callsPerRun - 1) / style.callsPerRun;
+
+    // A few untimed runs warm the page cache and the dynamic loader
+    double ignored;
+    struct rusage usage;
+    for (int i = 0; i < std::min(runs, 10); ++i) {
+        runOnce(style.argv, env, ignored, usage);
+    }
+
+    double cpuUs = 0;
+    int completed = 0;
+    for (int i = 0; i < runs; ++i) {
+        double latency = 0;
+        std::memset(&usage, 0, sizeof(usage));
+        if (!runOnce(style.argv, env, latency, usage)) {
+            std::fprintf(stderr, "%s: run failed\n", style.name.c_str());
+            continue;
+        }
+        if (style.callLog.empty()) {
+            result.latencyUs.push_back(latency);
+        } else {
+            readCallLog(style.callLog, result.latencyUs);
+        }
+        cpuUs += timevalUs(usage.ru_utime) + timevalUs(usage.ru_stime);
+        ++completed;
+    }
+    if (completed > 0) {
+        result.cpuUs = cpuUs / (static_cast<double>(completed) * style.callsPerRun);
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        result.maxRssKib = std::max(result.maxRssKib, peakRssKib(style.argv, env));
+    }
+    return result;
+}
+
+// Baseline lines: style<TAB>p50<TAB>p99<TAB>cpu<TAB>rss
+std::map<std::string, std::vector<double>> readBaseline(const std::string &path)
+{
+    std::map<std::string, std::vector<double>> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string style;
+        std::getline(fields, style, '\t');
+        std::vector<double> values;
+        double value;
+        while (fields >> value) {
+            values.push_back(value);
+        }
+        if (values.size() == 4) {
+            baseline[style] = values;
+        }
+    }
+    return baseline;
+}
+
+void removeTree(const std::string &root)
+{
+    std::string command = "rm -rf " + FileUtil::shellQuote(root);
+    if (std::system(command.c_str()) != 0) {
+        std::fprintf(stderr, "Cannot remove %s\n", root.c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int iterations = 2000;
+    double tolerance = 25.0;
+    std::string recordPath;
+    std::string baselinePath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--iterations") {
+            iterations = std::max(1, std::atoi(argv[i + 1]));
+        } else if (option == "--record") {
+            recordPath = argv[i + 1];
+        } else if (option == "--baseline") {
+            baselinePath = argv[i + 1];
+        } else if (option == "--tolerance") {
+            tolerance = std::atof(argv[i + 1]);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", option.c_str());
+            return 2;
+        }
+    }
+
+    // Both files are opened before the benchmark moves into its temporary directory
+    std::map<std::string, std::vector<double>> baseline;
+    if (!baselinePath.empty()) {
+        baseline = readBaseline(baselinePath);
+    }
+    std::ofstream record;
+    if (!recordPath.empty()) {
+        record.open(recordPath);
+        record << "# style\tp50_us\tp99_us\tcpu_us\trss_kib (" << iterations << " iterations)\n";
+    }
+
+    char rootTemplate[] = "/tmp/shorts_invocation_bench_XXXXXX";
+    if (!::mkdtemp(rootTemplate)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const std::string root = rootTemplate;
+
+    // Nothing from the caller's environment reaches the shortcuts
+    const std::string pathVar = "PATH=" + root + "/bin:/usr/bin:/bin";
+    const std::string homeVar = "HOME=" + root + "/home";
+    char *env[] = {const_cast<char *>(pathVar.c_str()), const_cast<char *>(homeVar.c_str()),
+                   const_cast<char *>("LC_ALL=C"), nullptr};
+
+    std::vector<Style> styles;
+    if (!prepare(root, styles) || ::chdir((root + "/home").c_str()) != 0) {
+        removeTree(root);
+        return 1;
+    }
+
+    std::printf("%-24s %9s %9s %9s %9s %9s %9s %8s\n", "style (us per call)", "mean", "p50", "p90",
+                "p99", "max", "cpu", "rss KiB");
+
+    int regressions = 0;
+    for (const Style &style : styles) {
+        Result result = measure(style, iterations, env);
+        if (result.latencyUs.empty()) {
+            ++regressions;
+            continue;
+        }
+
+        double mean = 0;
+        for (double latency : result.latencyUs) {
+            mean += latency;
+        }
+        mean /= static_cast<double>(result.latencyUs.size());
+        const double p50 = percentile(result.latencyUs, 50);
+        const double p99 = percentile(result.latencyUs, 99);
+
+        std::printf("%-24s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8ld", result.style.c_str(), mean, p50,
+                    percentile(result.latencyUs, 90), p99, percentile(result.latencyUs, 100),
+                    result.cpuUs, result.maxRssKib);
+
+        auto it = baseline.find(result.style);
+        if (it != baseline.end() && it->second[0] > 0) {
+            const double change = (p50 - it->second[0]) / it->second[0] * 100.0;
+            bool regressed = change > tolerance;
+            regressions += regressed;
+            std::printf("  p50 %+.1f%% vs baseline%s", change, regressed ? "  REGRESSION" : "");
+        }
+        if (it != baseline.end() && it->second[3] > 0 && result.maxRssKib > 0) {
+            const double change = (static_cast<double>(result.maxRssKib) - it->second[3]) / it->second[3] * 100.0;
+            bool regressed = change > tolerance;
+            regressions += regressed;
+            std::printf("  rss %+.1f%%%s", change, regressed ? "  REGRESSION" : "");
+        }
+        std::printf("\n");
+
+        if (record.is_open()) {
+            record << result.style << '\t' << p50 << '\t' << p99 << '\t' << result.cpuUs << '\t'
+                   << result.maxRssKib << '\n';
+        }
+    }
+
+    removeTree(root);
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+#include "bulkedit.h"
+#include "shortcutparser.h"
+
+namespace {
+
+bool &flagRef(CommandOptions &options, BulkEdit::Flag flag)
+{
+    switch (flag) {
+    case BulkEdit::Flag::Sudo:
+        return options.useSudo;
+    case BulkEdit::Flag::Background:
+        return options.runInBackground;
+    case BulkEdit::Flag::OpenEnded:
+        break;
+    }
+    return options.openEnded;
+}
+
+Shortcut normalized(const Shortcut &shortcut)
+{
+    Shortcut bare = shortcut;
+    bare.command = ShortcutParser::stripOptions(shortcut.command);
+    return bare;
+}
+
+} // namespace
+
+bool BulkEdit::hasFlag(const Shortcut &shortcut, Flag flag)
+{
+    CommandOptions options = shortcut.options;
+    return flagRef(options, flag);
+}
+
+Shortcut BulkEdit::withFlag(const Shortcut &shortcut, Flag flag, bool on)
+{
+    Shortcut result = normalized(shortcut);
+    flagRef(result.options, flag) = on;
+    return result;
+}
+
+Shortcut BulkEdit::withReplacement(const Shortcut &shortcut, const std::string &find,
+                                   const std::string &replacement)
+{
+    Shortcut result = normalized(shortcut);
+    if (find.empty()) {
+        return result;
+    }
+
+    std::string replaced;
+    size_t pos = 0;
+    for (;;) {
+        size_t hit = result.command.find(find, pos);
+        if (hit == std::string::npos) {
+            break;
+        }
+        replaced.append(result.command, pos, hit - pos);
+        replaced += replacement;
+        pos = hit + find.size();
+    }
+    replaced.append(result.command, pos, std::string::npos);
+    result.command = replaced;
+    return result;
+}
@@ -0,0 +1,23 @@
+#ifndef BULKEDIT_H
+#define BULKEDIT_H
+
+#include "shortcut.h"
+
+#include <string>
+
+// Transformations applied to many shortcuts at once. Each returns the shortcut
+// with its bare command and options, ready for ScriptGenerator or FunctionLibrary.
+class BulkEdit
+{
+public:
+    enum class Flag { Sudo, Background, OpenEnded };
+
+    static bool hasFlag(const Shortcut &shortcut, Flag flag);
+    static Shortcut withFlag(const Shortcut &shortcut, Flag flag, bool on);
+
+    // Replace every occurrence of find in the bare command
+    static Shortcut withReplacement(const Shortcut &shortcut, const std::string &find,
+                                    const std::string &replacement);
+};
+
+#endif // BULKEDIT_H
@@ -0,0 +1,222 @@
+#include "directorystore.h"
+#include "fileutil.h"
+#include "privilegedhelper.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DirectoryStore::DirectoryStore(std::string directory)
+    : m_directory(std::move(directory))
+{
+}
+
+std::string DirectoryStore::path(const std::string &name) const
+{
+    return m_directory + "/" + name;
+}
+
+bool DirectoryStore::available() const
+{
+    struct stat st;
+    return ::stat(m_directory.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool DirectoryStore::exists(const std::string &name) const
+{
+    struct stat st;
+    return ::stat(path(name).c_str(), &st) == 0;
+}
+
+std::vector<std::string> DirectoryStore::list() const
+{
+    TRACE_SCOPE("DirectoryStore::list", m_directory);
+    std::vector<std::string> names;
+
+    DIR *dir = ::opendir(m_directory.c_str());
+    if (!dir) {
+        return names;
+    }
+
+    int dirFd = ::dirfd(dir);
+    while (struct dirent *entry = ::readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        struct stat st;
+        if (::fstatat(dirFd, entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        if (::faccessat(dirFd, entry->d_name, X_OK, 0) != 0) {
+            continue;
+        }
+        names.emplace_back(entry->d_name);
+    }
+    ::closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::vector<ShortcutStore::Entry> DirectoryStore::entries() const
+{
+    TRACE_SCOPE("DirectoryStore::entries", m_directory);
+    std::vector<Entry> result;
+    int dirFd = ::open(m_directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return result;
+    }
+
+    for (std::string &name : list()) {
+        Entry entry;
+        entry.name = std::move(name);
+        FileClassifier::inspect(dirFd, entry.name, entry.info);
+        result.push_back(std::move(entry));
+    }
+    ::close(dirFd);
+    return result;
+}
+
+bool DirectoryStore::inspect(const std::string &name, FileClassifier::Info &info, std::string *error) const
+{
+    return FileClassifier::inspect(AT_FDCWD, path(name), info, error);
+}
+
+bool DirectoryStore::map(const std::string &name, Contents &contents, std::string *error) const
+{
+    TRACE_SCOPE("DirectoryStore::map", name);
+    const std::string file = path(name);
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) {
+            *error = FileUtil::errnoMessage("Cannot open " + file);
+        }
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= MAP_THRESHOLD) {
+        const size_t size = static_cast<size_t>(st.st_size);
+        void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            if (error) {
+                *error = FileUtil::errnoMessage("Cannot map " + file);
+            }
+            return false;
+        }
+        std::shared_ptr<const void> mapping(data, [size](const void *p) {
+            ::munmap(const_cast<void *>(p), size);
+        });
+        contents = Contents(std::move(mapping), std::string_view(static_cast<const char *>(data), size));
+        return true;
+    }
+    ::close(fd);
+
+    // Shortcuts are a few hundred bytes: copying them costs less than a mapping
+    // and cannot fault if someone truncates the file. Special files cannot be
+    // mapped at all.
+    auto buffer = std::make_shared<std::string>();
+    if (!FileUtil::readFile(file, *buffer, error)) {
+        return false;
+    }
+    std::string_view view(*buffer);
+    contents = Contents(std::move(buffer), view);
+    return true;
+}
+
+bool DirectoryStore::applyBatch(const std::vector<Operation> &operations, std::string *error)
+{
+    TRACE_SCOPE("DirectoryStore::applyBatch");
+    if (operations.empty()) {
+        return true;
+    }
+    if (!available()) {
+        if (error) {
+            *error = "The shortcuts directory does not exist: " + m_directory;
+        }
+        return false;
+    }
+    if (!validate(operations, error)) {
+        return false;
+    }
+
+    const bool direct = ::access(m_directory.c_str(), W_OK) == 0;
+
+    // Stage every new script before touching any existing one
+    std::vector<std::string> staged(operations.size());
+    bool ok = true;
+    for (size_t i = 0; ok && i < operations.size(); ++i) {
+        if (operations[i].type != Operation::Write) {
+            continue;
+        }
+        ok = direct
+            ? FileUtil::stageFile(path(operations[i].name), operations[i].content, 0755, staged[i], error)
+            : FileUtil::writeTemp("shortcut_", operations[i].content, 0755, staged[i], error);
+    }
+
+    if (ok && direct) {
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const std::string target = path(operations[i].name);
+            if (operations[i].type == Operation::Write) {
+                if (::rename(staged[i].c_str(), target.c_str()) == 0) {
+                    staged[i].clear();
+                } else if (ok) {
+                    if (error) {
+                        *error = FileUtil::errnoMessage("Failed to replace " + target);
+                    }
+                    ok = false;
+                }
+            } else if (::unlink(target.c_str()) != 0 && errno != ENOENT && ok) {
+                if (error) {
+                    *error = FileUtil::errnoMessage("Failed to delete " + target);
+                }
+                ok = false;
+            }
+        }
+    } else if (ok) {
+        // One helper script, one password prompt, for the whole batch. New
+        // scripts are copied next to their targets and renamed over them, so
+        // mapped readers never see a file change under them.
+        std::string script = "set -e\n";
+        for (size_t i = 0; i < operations.size(); ++i) {
+            if (operations[i].type == Operation::Write) {
+                std::string next = FileUtil::shellQuote(m_directory + "/." + operations[i].name + ".shorts-new");
+                script += "cp -f " + FileUtil::shellQuote(staged[i]) + " " + next
+                        + " && chmod 755 " + next + "\n";
+            }
+        }
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const std::string target = FileUtil::shellQuote(path(operations[i].name));
+            if (operations[i].type == Operation::Write) {
+                std::string next = FileUtil::shellQuote(m_directory + "/." + operations[i].name + ".shorts-new");
+                script += "mv -f " + next + " " + target + "\n";
+            } else {
+                script += "rm -f " + target + "\n";
+            }
+        }
+        ok = PrivilegedHelper::runScript(script, 30000, error);
+    }
+
+    for (const std::string &file : staged) {
+        if (!file.empty()) {
+            ::unlink(file.c_str());
+        }
+    }
+    return ok;
+}
+
+uint64_t DirectoryStore::version() const
+{
+    struct stat st;
+    if (::stat(m_directory.c_str(), &st) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(st.st_ctim.tv_sec) * 1000000000u + static_cast<uint64_t>(st.st_ctim.tv_nsec);
+}
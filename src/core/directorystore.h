@@ -0,0 +1,42 @@
+#ifndef DIRECTORYSTORE_H
+#define DIRECTORYSTORE_H
+
+#include "shortcutstore.h"
+
+#include <sys/types.h>
+
+// Shortcuts as executable files in one directory. Writes go straight to the
+// directory when it is writable and fall back to a pkexec helper otherwise.
+// Reads copy small files and special ones (a FIFO, say) into a buffer and map
+// regular files of MAP_THRESHOLD bytes or more.
+class DirectoryStore : public ShortcutStore
+{
+public:
+    static constexpr const char *SHORTCUT_DIR = "/usr/local/bin";
+    static constexpr off_t MAP_THRESHOLD = 64 * 1024;
+
+    explicit DirectoryStore(std::string directory = SHORTCUT_DIR);
+
+    std::string location() const override { return m_directory; }
+    std::string directory() const override { return m_directory; }
+    std::string path(const std::string &name) const override;
+
+    bool available() const override;
+    bool exists(const std::string &name) const override;
+    std::vector<std::string> list() const override;
+    std::vector<Entry> entries() const override;
+    bool inspect(const std::string &name, FileClassifier::Info &info, std::string *error = nullptr) const override;
+    bool map(const std::string &name, Contents &contents, std::string *error = nullptr) const override;
+
+    // When the directory is not writable the whole batch is one pkexec round-trip
+    bool applyBatch(const std::vector<Operation> &operations, std::string *error = nullptr) override;
+
+    // From the directory's change time, which every create, rename and unlink in
+    // it updates
+    uint64_t version() const override;
+
+private:
+    std::string m_directory;
+};
+
+#endif // DIRECTORYSTORE_H
@@ -0,0 +1,87 @@
+#include "fileclassifier.h"
+#include "fileutil.h"
+#include "stringutil.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileClassifier::Kind FileClassifier::classify(std::string_view header)
+{
+    if (StringUtil::startsWith(header, "\x7f" "ELF")) {
+        return Kind::Elf;
+    }
+    if (!StringUtil::startsWith(header, "#!")) {
+        return Kind::Other;
+    }
+
+    // The banner comment follows the shebang line in every generated script
+    return StringUtil::contains(header, "\n# Shortcut created with Shorts") ? Kind::Shortcut : Kind::Script;
+}
+
+bool FileClassifier::inspect(int dirFd, const std::string &path, Info &info, std::string *error)
+{
+    info = Info();
+    // O_NONBLOCK: opening a FIFO for reading would otherwise wait for a writer
+    int fd = ::openat(dirFd, path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        if (error) {
+            *error = FileUtil::errnoMessage("Cannot open " + path);
+        }
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return true; // not a regular file: Kind::Other
+    }
+    info.size = static_cast<uint64_t>(st.st_size);
+    info.modified = st.st_mtime;
+
+    char header[HEADER_BYTES];
+    ssize_t n;
+    do {
+        n = ::pread(fd, header, sizeof(header), 0);
+    } while (n < 0 && errno == EINTR);
+    ::close(fd);
+
+    if (n < 0) {
+        if (error) {
+            *error = FileUtil::errnoMessage("Cannot read " + path);
+        }
+        return false;
+    }
+
+    examine(std::string_view(header, static_cast<size_t>(n)), info);
+    return true;
+}
+
+void FileClassifier::examine(std::string_view header, Info &info)
+{
+    header = header.substr(0, HEADER_BYTES);
+    info.kind = classify(header);
+    info.interpreter.clear();
+    if (info.kind == Kind::Shortcut || info.kind == Kind::Script) {
+        std::string_view shebang = header.substr(2, header.find('\n') == std::string_view::npos
+                                                        ? std::string_view::npos
+                                                        : header.find('\n') - 2);
+        info.interpreter = StringUtil::trimmed(shebang);
+    }
+}
+
+const char *FileClassifier::describe(Kind kind)
+{
+    switch (kind) {
+    case Kind::Shortcut:
+        return "Shorts shortcut";
+    case Kind::Script:
+        return "Script";
+    case Kind::Elf:
+        return "ELF binary";
+    case Kind::Other:
+        break;
+    }
+    return "Executable";
+}
@@ -0,0 +1,43 @@
+#ifndef FILECLASSIFIER_H
+#define FILECLASSIFIER_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// What an executable in the shortcuts directory is, judged from its first
+// HEADER_BYTES only, so a multi-hundred-megabyte binary costs one small pread.
+class FileClassifier
+{
+public:
+    static constexpr size_t HEADER_BYTES = 512;
+
+    enum class Kind {
+        Shortcut,   // a script generated by Shorts
+        Script,     // some other #! script
+        Elf,        // a compiled binary
+        Other       // anything else (empty, another binary format, unreadable)
+    };
+
+    struct Info {
+        Kind kind = Kind::Other;
+        uint64_t size = 0;
+        time_t modified = 0;
+        std::string interpreter; // the #! line without "#!", for scripts
+    };
+
+    // Classify from the leading bytes of a file
+    static Kind classify(std::string_view header);
+
+    // Set kind and interpreter from the leading bytes of a file
+    static void examine(std::string_view header, Info &info);
+
+    // stat and pread the file at path; dirFd/relative paths work like openat()
+    static bool inspect(int dirFd, const std::string &path, Info &info, std::string *error = nullptr);
+
+    // Short human-readable name of a kind, e.g. "ELF binary"
+    static const char *describe(Kind kind);
+};
+
+#endif // FILECLASSIFIER_H
@@ -0,0 +1,163 @@
+#include "fileutil.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+bool writeAll(int fd, const std::string &content)
+{
+    const char *data = content.data();
+    size_t left = content.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void setError(std::string *error, const std::string &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+} // namespace
+
+namespace FileUtil {
+
+std::string errnoMessage(const std::string &what)
+{
+    return what + ": " + std::strerror(errno);
+}
+
+std::string shellQuote(const std::string &value)
+{
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += "'";
+    return quoted;
+}
+
+bool readFile(const std::string &path, std::string &content, std::string *error)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        setError(error, errnoMessage("Cannot open " + path));
+        return false;
+    }
+
+    content.clear();
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        content.reserve(static_cast<size_t>(st.st_size));
+    }
+
+    char buffer[8192];
+    for (;;) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            setError(error, errnoMessage("Cannot read " + path));
+            ::close(fd);
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        content.append(buffer, static_cast<size_t>(n));
+    }
+
+    ::close(fd);
+    return true;
+}
+
+bool stageFile(const std::string &path, const std::string &content, mode_t mode,
+               std::string &stagedPath, std::string *error)
+{
+    std::string::size_type slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    std::string base = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    stagedPath = dir + "/." + base + ".XXXXXX";
+    int fd = ::mkstemp(&stagedPath[0]);
+    if (fd < 0) {
+        setError(error, errnoMessage("Failed to create temporary file in " + dir));
+        stagedPath.clear();
+        return false;
+    }
+
+    bool ok = writeAll(fd, content) && ::fchmod(fd, mode) == 0 && ::fsync(fd) == 0;
+    if (!ok) {
+        setError(error, errnoMessage("Failed to write " + path));
+    }
+    ::close(fd);
+
+    if (!ok) {
+        ::unlink(stagedPath.c_str());
+        stagedPath.clear();
+    }
+    return ok;
+}
+
+bool writeAtomic(const std::string &path, const std::string &content, mode_t mode,
+                 std::string *error)
+{
+    std::string staged;
+    if (!stageFile(path, content, mode, staged, error)) {
+        return false;
+    }
+
+    if (::rename(staged.c_str(), path.c_str()) != 0) {
+        setError(error, errnoMessage("Failed to replace " + path));
+        ::unlink(staged.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool writeTemp(const std::string &prefix, const std::string &content, mode_t mode,
+               std::string &path, std::string *error)
+{
+    path = "/tmp/" + prefix + "XXXXXX";
+    int fd = ::mkstemp(&path[0]);
+    if (fd < 0) {
+        setError(error, errnoMessage("Failed to create temporary file"));
+        path.clear();
+        return false;
+    }
+
+    bool ok = writeAll(fd, content) && ::fchmod(fd, mode) == 0;
+    if (!ok) {
+        setError(error, errnoMessage("Failed to write temporary file"));
+    }
+    ::close(fd);
+
+    if (!ok) {
+        ::unlink(path.c_str());
+        path.clear();
+    }
+    return ok;
+}
+
+} // namespace FileUtil
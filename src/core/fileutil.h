@@ -0,0 +1,34 @@
+#ifndef FILEUTIL_H
+#define FILEUTIL_H
+
+#include <string>
+#include <sys/types.h>
+
+namespace FileUtil {
+
+// Read a whole file into content
+bool readFile(const std::string &path, std::string &content, std::string *error = nullptr);
+
+// Write content next to path under a temporary name and rename it into place, so
+// readers never observe a half-written file
+bool writeAtomic(const std::string &path, const std::string &content, mode_t mode,
+                 std::string *error = nullptr);
+
+// First half of writeAtomic: write content to a hidden temporary file next to
+// path and return its name in stagedPath, ready to be renamed over path
+bool stageFile(const std::string &path, const std::string &content, mode_t mode,
+               std::string &stagedPath, std::string *error = nullptr);
+
+// Create a uniquely named file under /tmp holding content; its path is returned in path
+bool writeTemp(const std::string &prefix, const std::string &content, mode_t mode,
+               std::string &path, std::string *error = nullptr);
+
+// Quote a string for safe use as a single word in a POSIX shell
+std::string shellQuote(const std::string &value);
+
+// strerror() wrapped in a std::string, prefixed with what was being attempted
+std::string errnoMessage(const std::string &what);
+
+} // namespace FileUtil
+
+#endif // FILEUTIL_H
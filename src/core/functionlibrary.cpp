@@ -0,0 +1,307 @@
+#include "functionlibrary.h"
+#include "fileutil.h"
+#include "privilegedhelper.h"
+#include "scriptgenerator.h"
+#include "shortcutparser.h"
+#include "stringutil.h"
+#include "trace.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace {
+
+const char *HEADER =
+    "# Shortcuts generated by Shorts -- Shortcut Manager Gui\n"
+    "# Sourced by login shells; source it from ~/.bashrc or /etc/bash.bashrc for the\n"
+    "# others. Manage these with shorts rather than by hand\n"
+    "[ -n \"${BASH_VERSION:-}${ZSH_VERSION:-}\" ] || return 0\n";
+
+const char *BEGIN_MARKER = "# >>> shorts: ";
+const char *END_MARKER = "# <<< shorts: ";
+
+// A broken profile.d file breaks every login shell, so never install one that
+// bash cannot parse
+bool checkSyntax(const std::string &content, std::string *error)
+{
+    TRACE_SCOPE("bash -n");
+    std::string tempPath;
+    if (!FileUtil::writeTemp("shorts_functions_", content, 0600, tempPath, error)) {
+        return false;
+    }
+
+    int errPipe[2];
+    if (::pipe2(errPipe, O_CLOEXEC) != 0) {
+        ::unlink(tempPath.c_str());
+        if (error) {
+            *error = FileUtil::errnoMessage("Failed to create pipe");
+        }
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    const char *argv[] = {"bash", "-n", tempPath.c_str(), nullptr};
+    pid_t pid = 0;
+    int rc = posix_spawnp(&pid, "bash", &actions, nullptr, const_cast<char *const *>(argv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(errPipe[1]);
+
+    // bash reports the first error only, so its output is short
+    std::string diagnostics;
+    char buffer[512];
+    ssize_t n;
+    while ((n = ::read(errPipe[0], buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR)) {
+        if (n > 0) {
+            diagnostics.append(buffer, static_cast<size_t>(n));
+        }
+    }
+    ::close(errPipe[0]);
+
+    int status = 0;
+    if (rc == 0) {
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    ::unlink(tempPath.c_str());
+
+    if (rc != 0) {
+        return true; // No bash to check with; nothing would source the file either
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (error) {
+            *error = "The command is not valid shell syntax";
+            std::string::size_type colon = diagnostics.find(": line ");
+            if (colon != std::string::npos) {
+                *error += " (" + StringUtil::trimmed(diagnostics.substr(colon + 2)) + ")";
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+FunctionLibrary::FunctionLibrary(std::string path)
+    : m_path(std::move(path))
+{
+}
+
+std::string FunctionLibrary::renderBlock(const Shortcut &shortcut)
+{
+    std::string block = BEGIN_MARKER + shortcut.name + "\n";
+    block += shortcut.name + "() {\n";
+    block += "    " + ScriptGenerator::commandLine(shortcut.command, shortcut.options) + "\n";
+    block += "}\n";
+    block += END_MARKER + shortcut.name + "\n";
+    return block;
+}
+
+bool FunctionLibrary::load(std::string *error)
+{
+    TRACE_SCOPE("FunctionLibrary::load", m_path);
+    m_blocks.clear();
+    m_shortcuts.clear();
+    m_size = -1;
+
+    struct stat st;
+    if (::stat(m_path.c_str(), &st) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        if (error) {
+            *error = FileUtil::errnoMessage("Cannot stat " + m_path);
+        }
+        return false;
+    }
+
+    std::string content;
+    if (!FileUtil::readFile(m_path, content, error)) {
+        return false;
+    }
+    m_mtime = st.st_mtim;
+    m_size = st.st_size;
+
+    std::string name;
+    std::string block;
+    std::string body;
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos) {
+            end = content.size();
+        }
+        std::string_view line(content.data() + pos, end - pos);
+        pos = end + 1;
+
+        if (name.empty()) {
+            if (StringUtil::startsWith(line, BEGIN_MARKER)) {
+                name = std::string(line.substr(std::char_traits<char>::length(BEGIN_MARKER)));
+                block = std::string(line) + "\n";
+                body.clear();
+            }
+            continue;
+        }
+
+        block += std::string(line) + "\n";
+        if (StringUtil::startsWith(line, END_MARKER)) {
+            // The body is the line inside "name() {" ... "}"; the command is kept
+            // bare so that rendering it again does not repeat the decorations
+            Shortcut shortcut;
+            shortcut.name = name;
+            shortcut.command = ShortcutParser::stripOptions(body);
+            shortcut.options = ShortcutParser::detectOptions(body);
+            m_shortcuts[name] = shortcut;
+            m_blocks[name] = block;
+            name.clear();
+        } else {
+            std::string_view trimmed = StringUtil::trimmedView(line);
+            if (!trimmed.empty() && trimmed != "}" && !StringUtil::endsWith(trimmed, "() {")) {
+                body = std::string(trimmed);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FunctionLibrary::reloadIfChanged(std::string *error)
+{
+    struct stat st;
+    bool exists = ::stat(m_path.c_str(), &st) == 0;
+    bool changed = exists
+        ? (st.st_size != m_size || st.st_mtim.tv_sec != m_mtime.tv_sec
+           || st.st_mtim.tv_nsec != m_mtime.tv_nsec)
+        : m_size >= 0;
+    return changed ? load(error) : true;
+}
+
+std::vector<std::string> FunctionLibrary::list() const
+{
+    std::vector<std::string> names;
+    names.reserve(m_shortcuts.size());
+    for (const auto &entry : m_shortcuts) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+bool FunctionLibrary::contains(const std::string &name) const
+{
+    return m_shortcuts.count(name) > 0;
+}
+
+bool FunctionLibrary::get(const std::string &name, Shortcut &shortcut) const
+{
+    auto it = m_shortcuts.find(name);
+    if (it == m_shortcuts.end()) {
+        return false;
+    }
+    shortcut = it->second;
+    return true;
+}
+
+bool FunctionLibrary::upsert(const Shortcut &shortcut, std::string *error)
+{
+    return update({shortcut}, {}, error);
+}
+
+bool FunctionLibrary::remove(const std::string &name, std::string *error)
+{
+    return update({}, {name}, error);
+}
+
+bool FunctionLibrary::update(const std::vector<Shortcut> &upserts,
+                             const std::vector<std::string> &removals, std::string *error)
+{
+    if (!reloadIfChanged(error)) {
+        return false;
+    }
+
+    std::map<std::string, std::string> blocks = m_blocks;
+    std::map<std::string, Shortcut> shortcuts = m_shortcuts;
+
+    for (const std::string &name : removals) {
+        blocks.erase(name);
+        shortcuts.erase(name);
+    }
+
+    for (const Shortcut &shortcut : upserts) {
+        if (!ShortcutParser::isValidName(shortcut.name)) {
+            if (error) {
+                *error = "Invalid shortcut name: " + shortcut.name;
+            }
+            return false;
+        }
+
+        // Only the changed shortcut is re-rendered; it is kept as load() would
+        // read it back
+        const std::string line = ScriptGenerator::commandLine(shortcut.command, shortcut.options);
+        Shortcut stored = shortcut;
+        stored.command = ShortcutParser::stripOptions(line);
+        stored.options = ShortcutParser::detectOptions(line);
+        blocks[shortcut.name] = renderBlock(shortcut);
+        shortcuts[shortcut.name] = stored;
+    }
+
+    std::swap(blocks, m_blocks);
+    std::swap(shortcuts, m_shortcuts);
+    if (!save(error)) {
+        std::swap(blocks, m_blocks);
+        std::swap(shortcuts, m_shortcuts);
+        return false;
+    }
+    return true;
+}
+
+bool FunctionLibrary::save(std::string *error)
+{
+    TRACE_SCOPE("FunctionLibrary::save", m_path);
+    std::string content = HEADER;
+    for (const auto &entry : m_blocks) {
+        content += "\n";
+        content += entry.second;
+    }
+
+    if (!checkSyntax(content, error)) {
+        return false;
+    }
+
+    std::string::size_type slash = m_path.rfind('/');
+    std::string dir = slash == std::string::npos ? std::string(".") : m_path.substr(0, slash);
+
+    bool ok = false;
+    if (::access(dir.c_str(), W_OK) == 0) {
+        ok = FileUtil::writeAtomic(m_path, content, 0644, error);
+    } else {
+        // Otherwise a pkexec helper installs it; the final mv keeps the swap atomic
+        std::string tempPath;
+        if (!FileUtil::writeTemp("shorts_functions_", content, 0644, tempPath, error)) {
+            return false;
+        }
+        std::string target = FileUtil::shellQuote(m_path);
+        std::string staged = FileUtil::shellQuote(m_path + ".new");
+        std::string script = "cp -f " + FileUtil::shellQuote(tempPath) + " " + staged
+                           + " && chmod 644 " + staged + " && mv -f " + staged + " " + target + "\n";
+        ok = PrivilegedHelper::runScript(script, 10000, error);
+        ::unlink(tempPath.c_str());
+    }
+
+    if (ok) {
+        struct stat st;
+        if (::stat(m_path.c_str(), &st) == 0) {
+            m_mtime = st.st_mtim;
+            m_size = st.st_size;
+        }
+    }
+    return ok;
+}
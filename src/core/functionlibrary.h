@@ -0,0 +1,58 @@
+#ifndef FUNCTIONLIBRARY_H
+#define FUNCTIONLIBRARY_H
+
+#include "shortcut.h"
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// Alternative output mode: every shortcut becomes a shell function in a single
+// file that a shell sources once, so calling a shortcut costs no fork or exec.
+// The default path is under /etc/profile.d, which only login shells read;
+// interactive non-login shells have to source it from their rc file.
+//
+// Each shortcut owns a block delimited by marker comments. Updates re-render only
+// the blocks that changed, keep the others byte for byte, and replace the file
+// atomically. The file is re-read first if it changed on disk since it was last
+// loaded.
+class FunctionLibrary
+{
+public:
+    static constexpr const char *LIBRARY_PATH = "/etc/profile.d/shorts.sh";
+
+    explicit FunctionLibrary(std::string path = LIBRARY_PATH);
+
+    const std::string &path() const { return m_path; }
+
+    // Read the library; a missing file is an empty library
+    bool load(std::string *error = nullptr);
+
+    std::vector<std::string> list() const;
+    bool contains(const std::string &name) const;
+    bool get(const std::string &name, Shortcut &shortcut) const;
+
+    bool upsert(const Shortcut &shortcut, std::string *error = nullptr);
+    bool remove(const std::string &name, std::string *error = nullptr);
+
+    // Apply several changes with a single rewrite of the file
+    bool update(const std::vector<Shortcut> &upserts, const std::vector<std::string> &removals,
+                std::string *error = nullptr);
+
+    // The function definition for one shortcut, including its markers
+    static std::string renderBlock(const Shortcut &shortcut);
+
+private:
+    bool reloadIfChanged(std::string *error);
+    bool save(std::string *error);
+
+    std::string m_path;
+    std::map<std::string, std::string> m_blocks; // name -> rendered block
+    std::map<std::string, Shortcut> m_shortcuts;
+    struct timespec m_mtime = {0, 0};
+    off_t m_size = -1;
+};
+
+#endif // FUNCTIONLIBRARY_H
@@ -0,0 +1,518 @@
+#include "healthcheck.h"
+#include "fileclassifier.h"
+#include "scriptgenerator.h"
+#include "shortcutparser.h"
+#include "shortcutstore.h"
+#include "stringutil.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using Finding = HealthCheck::Finding;
+using Problem = HealthCheck::Problem;
+
+// The words of each simple command in a command line, quotes removed. Words
+// that need the shell to expand them are marked by an empty string, and
+// redirection targets are left out.
+std::vector<std::vector<std::string>> simpleCommands(std::string_view line)
+{
+    std::vector<std::vector<std::string>> commands(1);
+    std::string word;
+    bool inWord = false;
+    bool expands = false;
+    bool redirect = false;
+    char quote = 0;
+
+    auto endWord = [&]() {
+        if (inWord) {
+            if (!redirect) {
+                commands.back().push_back(expands ? std::string() : word);
+            }
+            redirect = false;
+        }
+        word.clear();
+        inWord = false;
+        expands = false;
+    };
+
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quote) {
+            if (c == quote) {
+                quote = 0;
+            } else if (c == '\\' && quote == '"' && i + 1 < line.size()) {
+                word += line[++i];
+            } else {
+                expands = expands || (quote == '"' && (c == '$' || c == '`'));
+                word += c;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            inWord = true;
+        } else if (c == '\\' && i + 1 < line.size()) {
+            word += line[++i];
+            inWord = true;
+        } else if (c == ' ' || c == '\t') {
+            endWord();
+        } else if (c == '&' && i + 1 < line.size() && line[i + 1] == '>') {
+            endWord(); // &> file
+            redirect = true;
+            ++i;
+        } else if (c == ';' || c == '&' || c == '|' || c == '(' || c == ')' || c == '\n') {
+            endWord();
+            redirect = false;
+            if (!commands.back().empty()) {
+                commands.emplace_back();
+            }
+        } else if (c == '<' || c == '>') {
+            // "2>" names a descriptor, not an argument
+            inWord = inWord && word.find_first_not_of("0123456789") != std::string::npos;
+            endWord();
+            redirect = true;
+            if (i + 1 < line.size() && (line[i + 1] == '&' || line[i + 1] == c)) {
+                ++i; // 2>&1, >>, <<
+            }
+        } else {
+            expands = expands || c == '$' || c == '`' || c == '*' || c == '?' || c == '[' || c == '{';
+            word += c;
+            inWord = true;
+        }
+    }
+    endWord();
+    if (commands.back().empty()) {
+        commands.pop_back();
+    }
+    return commands;
+}
+
+bool isShellWord(const std::string &word)
+{
+    static const std::set<std::string> builtins = {
+        "!", ".", ":", "[", "[[", "{", "}", "alias", "bg", "break", "builtin", "case", "cd",
+        "continue", "declare", "do", "done", "echo", "elif", "else", "esac", "eval", "exit",
+        "export", "false", "fg", "fi", "for", "function", "if", "jobs", "kill", "let", "local",
+        "printf", "pwd", "read", "readonly", "return", "select", "set", "shift", "source", "test",
+        "then", "trap", "true", "type", "ulimit", "umask", "unalias", "unset", "until", "wait",
+        "while"};
+    return builtins.count(word) > 0;
+}
+
+bool isAssignment(const std::string &word)
+{
+    size_t eq = word.find('=');
+    return eq != std::string::npos && eq > 0
+        && word.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_") == eq;
+}
+
+std::string expandHome(const std::string &path)
+{
+    if (StringUtil::startsWith(path, "~/")) {
+        const char *home = std::getenv("HOME");
+        return std::string(home ? home : "") + path.substr(1);
+    }
+    return path;
+}
+
+const std::vector<std::string> &searchPath()
+{
+    // The shortcut runs in the user's PATH, which may differ from ours under
+    // pkexec; include the usual system directories either way
+    static const std::vector<std::string> directories = [] {
+        std::vector<std::string> result;
+        std::string path = "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin";
+        if (const char *env = std::getenv("PATH")) {
+            path = std::string(env) + ":" + path;
+        }
+        size_t begin = 0;
+        while (begin <= path.size()) {
+            size_t end = path.find(':', begin);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            std::string directory = path.substr(begin, end - begin);
+            if (!directory.empty() && std::find(result.begin(), result.end(), directory) == result.end()) {
+                result.push_back(directory);
+            }
+            begin = end + 1;
+        }
+        return result;
+    }();
+    return directories;
+}
+
+// Full path of a command found through PATH, or empty
+std::string resolveCommand(const std::string &command)
+{
+    for (const std::string &directory : searchPath()) {
+        std::string candidate = directory + "/" + command;
+        struct stat st;
+        if (::stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode)
+            && ::access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+    }
+    return std::string();
+}
+
+bool checkPath(const std::string &name, const std::string &path, bool executable,
+               std::vector<Finding> &findings)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        if (errno == EACCES) {
+            findings.push_back({name, Problem::PermissionDenied, path, "a parent directory cannot be searched"});
+            return false;
+        }
+        if (!executable) {
+            // A missing file in an existing directory may be an output; only a
+            // missing directory means the path went stale
+            std::string::size_type slash = path.rfind('/');
+            std::string parent = slash == 0 ? std::string("/") : path.substr(0, slash);
+            if (slash != std::string::npos && ::access(parent.c_str(), F_OK) == 0) {
+                return true;
+            }
+        }
+        findings.push_back({name, Problem::Missing, path,
+                            executable ? "command does not exist" : "path argument does not exist"});
+        return false;
+    }
+
+    if (executable && (S_ISDIR(st.st_mode) || ::access(path.c_str(), X_OK) != 0)) {
+        findings.push_back({name, Problem::NotExecutable, path,
+                            S_ISDIR(st.st_mode) ? "is a directory" : "no execute permission"});
+        return false;
+    }
+    return true;
+}
+
+// The interpreter of a #! line (and the command after /usr/bin/env) must exist
+void checkInterpreter(const std::string &name, const std::string &interpreter, const std::string &owner,
+                      std::vector<Finding> &findings)
+{
+    std::vector<std::vector<std::string>> words = simpleCommands(interpreter);
+    if (words.empty() || words[0].empty() || words[0][0].empty()) {
+        return;
+    }
+
+    const std::string &program = words[0][0];
+    struct stat st;
+    if (::stat(program.c_str(), &st) != 0 || ::access(program.c_str(), X_OK) != 0) {
+        findings.push_back({name, Problem::BadInterpreter, program, "interpreter of " + owner + " is missing"});
+        return;
+    }
+
+    if (StringUtil::endsWith(program, "/env")) {
+        for (size_t i = 1; i < words[0].size(); ++i) {
+            const std::string &argument = words[0][i];
+            if (argument.empty() || argument[0] == '-' || isAssignment(argument)) {
+                continue;
+            }
+            if (resolveCommand(argument).empty()) {
+                findings.push_back({name, Problem::BadInterpreter, argument,
+                                    "interpreter of " + owner + " is not in PATH"});
+            }
+            break;
+        }
+    }
+}
+
+std::string shebangOf(std::string_view content)
+{
+    if (!StringUtil::startsWith(content, "#!")) {
+        return std::string();
+    }
+    size_t end = content.find('\n');
+    return StringUtil::trimmed(content.substr(2, end == std::string_view::npos ? end : end - 2));
+}
+
+} // namespace
+
+HealthCheck::HealthCheck(unsigned threads)
+    : m_threads(threads)
+    , m_pool(std::make_unique<ThreadPool>(threads))
+{
+}
+
+HealthCheck::~HealthCheck()
+{
+    reap();
+    // A task still stuck may never return (a hung mount), and joining its pool
+    // would hang whoever destroys this. Those pools are leaked on purpose: their
+    // threads only ever touch state the tasks share, and end with the process.
+    for (Retired &retired : m_retired) {
+        retired.pool.release();
+    }
+}
+
+void HealthCheck::reap()
+{
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+                                   [](const Retired &retired) { return !retired.busy(); }),
+                    m_retired.end());
+}
+
+std::vector<HealthCheck::Finding> HealthCheck::check(const std::string &name, const std::string &commandLine,
+                                                     const std::string &interpreter)
+{
+    std::vector<Finding> findings;
+    if (!interpreter.empty()) {
+        checkInterpreter(name, interpreter, "the shortcut", findings);
+    }
+
+    for (const std::vector<std::string> &words : simpleCommands(commandLine)) {
+        // Skip what only wraps the real command
+        size_t i = 0;
+        while (i < words.size()) {
+            const std::string &word = words[i];
+            if (word == "sudo" || word == "nohup" || word == "exec" || word == "command"
+                || word == "time" || word == "env" || isAssignment(word)) {
+                ++i;
+            } else if (i > 0 && words[i - 1] == "sudo" && !word.empty() && word[0] == '-') {
+                ++i; // sudo -E, sudo -H ...
+            } else {
+                break;
+            }
+        }
+        if (i >= words.size() || words[i].empty() || isShellWord(words[i])) {
+            continue;
+        }
+
+        // The command itself
+        std::string command = expandHome(words[i]);
+        std::string resolved;
+        if (command.find('/') != std::string::npos) {
+            if (checkPath(name, command, true, findings)) {
+                resolved = command;
+            }
+        } else {
+            resolved = resolveCommand(command);
+            if (resolved.empty()) {
+                findings.push_back({name, Problem::Missing, command, "command not found in PATH"});
+            }
+        }
+
+        // A script target needs its own interpreter
+        FileClassifier::Info info;
+        if (!resolved.empty() && FileClassifier::inspect(AT_FDCWD, resolved, info)
+            && !info.interpreter.empty()) {
+            checkInterpreter(name, info.interpreter, resolved, findings);
+        }
+
+        // Absolute and home-relative path arguments
+        for (size_t arg = i + 1; arg < words.size(); ++arg) {
+            const std::string &word = words[arg];
+            if (!word.empty() && (word[0] == '/' || StringUtil::startsWith(word, "~/"))) {
+                checkPath(name, expandHome(word), false, findings);
+            }
+        }
+    }
+    return findings;
+}
+
+HealthCheck::Report HealthCheck::run(std::shared_ptr<const ShortcutStore> store,
+                                     const std::vector<std::string> &names, int timeoutMs,
+                                     const Progress &progress,
+                                     const std::atomic<bool> *cancel)
+{
+    // Tasks copy what they use: a stuck one may finish after this returns
+    return run(names, [store, names](size_t index) {
+        const std::string &name = names[index];
+        ShortcutStore::Contents contents;
+        std::string error;
+        if (!store->map(name, contents, &error)) {
+            return std::vector<Finding>{{name, Problem::Unreadable, store->path(name), error}};
+        }
+        return check(name, ShortcutParser::commandLine(contents.view()), shebangOf(contents.view()));
+    }, timeoutMs, progress, cancel);
+}
+
+HealthCheck::Report HealthCheck::run(const std::vector<Shortcut> &shortcuts, int timeoutMs,
+                                     const Progress &progress, const std::atomic<bool> *cancel)
+{
+    std::vector<std::string> names;
+    names.reserve(shortcuts.size());
+    for (const Shortcut &shortcut : shortcuts) {
+        names.push_back(shortcut.name);
+    }
+    return run(names, [shortcuts](size_t index) {
+        const Shortcut &shortcut = shortcuts[index];
+        return check(shortcut.name, ScriptGenerator::commandLine(shortcut.command, shortcut.options));
+    }, timeoutMs, progress, cancel);
+}
+
+HealthCheck::Report HealthCheck::run(const std::vector<std::string> &names,
+                                     const std::function<std::vector<Finding>(size_t)> &task,
+                                     int timeoutMs, const Progress &progress,
+                                     const std::atomic<bool> *cancel)
+{
+    TRACE_SCOPE("HealthCheck::run");
+    reap();
+    using Clock = std::chrono::steady_clock;
+    enum Status : char { Queued, Running, Done, Abandoned, Cancelled };
+
+    // Shared with the tasks, which may outlive this call if one is stuck in a
+    // system call past its timeout
+    struct State {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<Status> status;
+        std::vector<Clock::time_point> started;
+        std::vector<std::vector<Finding>> results;
+        size_t finished = 0;
+        size_t running = 0; // tasks inside (*work)(), including abandoned ones
+
+        // Held while reporting progress; closed once run() is about to return,
+        // when the callback and whatever it refers to may be gone
+        std::mutex progressMutex;
+        bool closed = false;
+    };
+    auto state = std::make_shared<State>();
+    const size_t total = names.size();
+    state->status.assign(total, Queued);
+    state->started.resize(total);
+    state->results.resize(total);
+
+    Report report;
+    const Clock::time_point begin = Clock::now();
+    auto work = std::make_shared<std::function<std::vector<Finding>(size_t)>>(task);
+
+    for (size_t index = 0; index < total; ++index) {
+        m_pool->submit([state, work, index, total, progress]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->status[index] != Queued) {
+                    return;
+                }
+                state->status[index] = Running;
+                state->started[index] = Clock::now();
+                ++state->running;
+            }
+
+            std::vector<Finding> findings = (*work)(index);
+
+            size_t done = 0;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                --state->running;
+                if (state->status[index] != Running) {
+                    return; // already reported as timed out
+                }
+                state->status[index] = Done;
+                state->results[index] = std::move(findings);
+                done = ++state->finished;
+            }
+            state->changed.notify_all();
+            if (progress) {
+                std::lock_guard<std::mutex> guard(state->progressMutex);
+                if (!state->closed) {
+                    progress(done, total);
+                }
+            }
+        });
+    }
+
+    // Watch the clock: a task over its timeout is written off, and if nothing
+    // finishes for a whole timeout the queued tasks are stuck behind it
+    const auto timeout = std::chrono::milliseconds(timeoutMs);
+    std::unique_lock<std::mutex> lock(state->mutex);
+    const auto tick = std::chrono::milliseconds(20);
+    Clock::time_point lastProgress = Clock::now();
+    Clock::time_point lastScan = lastProgress;
+    size_t lastFinished = 0;
+    while (state->finished < total) {
+        state->changed.wait_for(lock, tick);
+        const Clock::time_point now = Clock::now();
+        if (state->finished != lastFinished) {
+            lastFinished = state->finished;
+            lastProgress = now;
+        }
+
+        if (cancel && cancel->load()) {
+            for (Status &status : state->status) {
+                if (status == Queued || status == Running) {
+                    status = Cancelled;
+                }
+            }
+            report.cancelled = true;
+            break;
+        }
+
+        // Scanning for overdue tasks on every completion would be quadratic
+        if (now - lastScan < tick) {
+            continue;
+        }
+        lastScan = now;
+
+        const bool stalled = now - lastProgress > timeout;
+        for (size_t index = 0; index < total; ++index) {
+            Status &status = state->status[index];
+            bool overdue = status == Running && now - state->started[index] > timeout;
+            if (overdue || (stalled && status == Queued)) {
+                status = Abandoned;
+                state->results[index] = {{names[index], Problem::Timeout, std::string(),
+                                          overdue ? "check did not finish in time"
+                                                  : "check never started: every worker is stuck"}};
+                ++state->finished;
+            }
+        }
+    }
+
+    for (size_t index = 0; index < total; ++index) {
+        if (state->status[index] == Done || state->status[index] == Abandoned) {
+            ++report.checked;
+            for (Finding &finding : state->results[index]) {
+                report.findings.push_back(std::move(finding));
+            }
+        }
+    }
+    const bool stuck = state->running > 0;
+    lock.unlock();
+    {
+        std::lock_guard<std::mutex> guard(state->progressMutex);
+        state->closed = true;
+    }
+
+    // Workers still inside a check may never come back (a hung mount): keep them
+    // from shrinking the next run's pool
+    if (stuck) {
+        m_retired.push_back({std::move(m_pool), [state]() {
+                                 std::lock_guard<std::mutex> guard(state->mutex);
+                                 return state->running > 0;
+                             }});
+        m_pool = std::make_unique<ThreadPool>(m_threads);
+    }
+
+    report.elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+    return report;
+}
+
+const char *HealthCheck::describe(Problem problem)
+{
+    switch (problem) {
+    case Problem::Missing:
+        return "Missing";
+    case Problem::NotExecutable:
+        return "Not executable";
+    case Problem::PermissionDenied:
+        return "Permission denied";
+    case Problem::BadInterpreter:
+        return "Bad interpreter";
+    case Problem::Unreadable:
+        return "Unreadable";
+    case Problem::Timeout:
+        break;
+    }
+    return "Timed out";
+}
@@ -0,0 +1,94 @@
+#ifndef HEALTHCHECK_H
+#define HEALTHCHECK_H
+
+#include "shortcut.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ShortcutStore;
+
+// Finds shortcuts that no longer work: a command that is gone or not
+// executable, an interpreter that was uninstalled, a path argument whose
+// directory disappeared. Every shortcut is one task on a work-stealing pool; a
+// task that exceeds the per-file timeout (a hung network mount, say) is reported
+// as such instead of holding up the report. A run that leaves a task stuck
+// retires its pool and later runs use a fresh one; retired pools are joined once
+// their stuck tasks return. Progress is never reported after run() returns.
+class HealthCheck
+{
+public:
+    enum class Problem {
+        Missing,          // command or path does not exist
+        NotExecutable,    // exists but cannot be executed
+        PermissionDenied, // a directory on the way cannot be searched
+        BadInterpreter,   // the #! interpreter of the shortcut or its target is missing
+        Unreadable,       // the shortcut itself cannot be read
+        Timeout           // the check did not finish within the per-file timeout
+    };
+
+    struct Finding {
+        std::string name;   // the shortcut
+        Problem problem = Problem::Missing;
+        std::string target; // the command, path or interpreter at fault
+        std::string detail;
+    };
+
+    struct Report {
+        size_t checked = 0;
+        std::vector<Finding> findings;
+        int64_t elapsedNs = 0;
+        bool cancelled = false;
+    };
+
+    // Called from pool threads with the number of shortcuts done so far
+    using Progress = std::function<void(size_t done, size_t total)>;
+
+    static constexpr int DEFAULT_TIMEOUT_MS = 2000;
+
+    explicit HealthCheck(unsigned threads = 0);
+    ~HealthCheck();
+
+    // Read, parse and check the named scripts of store. The tasks share the store,
+    // so one stuck past its timeout can still finish reading after the caller
+    // has let go of it.
+    Report run(std::shared_ptr<const ShortcutStore> store, const std::vector<std::string> &names,
+               int timeoutMs = DEFAULT_TIMEOUT_MS, const Progress &progress = Progress(),
+               const std::atomic<bool> *cancel = nullptr);
+
+    // Check shortcuts already in memory, e.g. those of the function library
+    Report run(const std::vector<Shortcut> &shortcuts, int timeoutMs = DEFAULT_TIMEOUT_MS,
+               const Progress &progress = Progress(), const std::atomic<bool> *cancel = nullptr);
+
+    // The checks for one shortcut's command line, and for the interpreter on its
+    // #! line if it has one. Thread-safe.
+    static std::vector<Finding> check(const std::string &name, const std::string &commandLine,
+                                      const std::string &interpreter = std::string());
+
+    static const char *describe(Problem problem);
+
+private:
+    Report run(const std::vector<std::string> &names, const std::function<std::vector<Finding>(size_t)> &task,
+               int timeoutMs, const Progress &progress, const std::atomic<bool> *cancel);
+
+    // A pool with a task that outlived its run, and whether any still has not
+    // returned
+    struct Retired {
+        std::unique_ptr<ThreadPool> pool;
+        std::function<bool()> busy;
+    };
+
+    // Join the retired pools whose tasks have all returned
+    void reap();
+
+    unsigned m_threads;
+    std::unique_ptr<ThreadPool> m_pool;
+    std::vector<Retired> m_retired;
+};
+
+#endif // HEALTHCHECK_H
@@ -0,0 +1,682 @@
+#include "historypack.h"
+#include "fileutil.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+const char FILE_MAGIC[8] = {'S', 'H', 'O', 'R', 'T', 'P', 'K', '1'};
+const uint32_t RECORD_MAGIC = 0x56524853; // "SHRV"
+const size_t HEADER_SIZE = 48;
+
+enum RecordKind : uint8_t {
+    Keyframe = 0,
+    Delta = 1,
+};
+
+enum RecordFlags : uint8_t {
+    Deflated = 1,
+};
+
+void put16(unsigned char *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+void put32(unsigned char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+
+void put64(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+
+uint16_t get16(const unsigned char *p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const unsigned char *p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+uint64_t get64(const unsigned char *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+void putVarint(std::string &out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+bool getVarint(const std::string &in, size_t &pos, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(in[pos++]);
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Edits to a shortcut touch one line, so a common prefix/suffix delta captures
+// them exactly: [varint prefix][varint suffix][replacement bytes]
+std::string makeDelta(const std::string &base, const std::string &target)
+{
+    size_t limit = std::min(base.size(), target.size());
+    size_t prefix = 0;
+    while (prefix < limit && base[prefix] == target[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < limit - prefix
+           && base[base.size() - 1 - suffix] == target[target.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    std::string delta;
+    putVarint(delta, prefix);
+    putVarint(delta, suffix);
+    delta.append(target, prefix, target.size() - prefix - suffix);
+    return delta;
+}
+
+bool applyDelta(const std::string &base, const std::string &delta, std::string &out)
+{
+    size_t pos = 0;
+    uint64_t prefix = 0;
+    uint64_t suffix = 0;
+    if (!getVarint(delta, pos, prefix) || !getVarint(delta, pos, suffix)
+        || prefix + suffix > base.size()) {
+        return false;
+    }
+
+    out.assign(base, 0, prefix);
+    out.append(delta, pos, std::string::npos);
+    out.append(base, base.size() - suffix, suffix);
+    return true;
+}
+
+bool preadAll(int fd, void *buffer, size_t size, uint64_t offset)
+{
+    char *p = static_cast<char *>(buffer);
+    while (size > 0) {
+        ssize_t n = ::pread(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool pwriteAll(int fd, const void *buffer, size_t size, uint64_t offset)
+{
+    const char *p = static_cast<const char *>(buffer);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+void setError(std::string *error, const std::string &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+int openPack(const std::string &path, uint64_t &end, std::string *error)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        setError(error, FileUtil::errnoMessage("Cannot open history pack " + path));
+        return -1;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        setError(error, FileUtil::errnoMessage("Cannot stat history pack " + path));
+        ::close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        if (!pwriteAll(fd, FILE_MAGIC, sizeof(FILE_MAGIC), 0)) {
+            setError(error, FileUtil::errnoMessage("Cannot initialise history pack " + path));
+            ::close(fd);
+            return -1;
+        }
+        end = sizeof(FILE_MAGIC);
+        return fd;
+    }
+
+    char magic[sizeof(FILE_MAGIC)];
+    if (!preadAll(fd, magic, sizeof(magic), 0) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0) {
+        setError(error, "Not a Shorts history pack: " + path);
+        ::close(fd);
+        return -1;
+    }
+
+    end = static_cast<uint64_t>(st.st_size);
+    return fd;
+}
+
+} // namespace
+
+struct HistoryPack::RecordHeader {
+    uint8_t kind = Keyframe;
+    uint8_t flags = 0;
+    uint16_t nameLength = 0;
+    uint32_t version = 0;
+    uint32_t contentSize = 0;
+    uint32_t rawSize = 0;
+    uint32_t storedSize = 0;
+    uint32_t crc = 0;
+    int64_t timestamp = 0;
+    uint64_t baseOffset = 0;
+
+    uint64_t recordSize() const { return HEADER_SIZE + nameLength + storedSize; }
+};
+
+// Exclusive flock() on the pack for as long as it lives. Every process that
+// writes the pack (the window, --compact-history) appends or replaces it only
+// while holding this.
+class HistoryPack::Lock
+{
+public:
+    explicit Lock(int fd)
+        : m_fd(fd)
+    {
+        while (::flock(m_fd, LOCK_EX) != 0 && errno == EINTR) {
+        }
+    }
+    ~Lock() { ::flock(m_fd, LOCK_UN); }
+
+    Lock(const Lock &) = delete;
+    Lock &operator=(const Lock &) = delete;
+
+private:
+    int m_fd;
+};
+
+HistoryPack::HistoryPack(std::string path)
+    : m_path(std::move(path))
+{
+}
+
+HistoryPack::~HistoryPack()
+{
+    close();
+}
+
+void HistoryPack::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_index.clear();
+    m_depth.clear();
+    m_end = 0;
+}
+
+bool HistoryPack::open(std::string *error)
+{
+    TRACE_SCOPE("HistoryPack::open", m_path);
+    close();
+
+    // Make sure the parent directory exists
+    std::string::size_type slash = m_path.rfind('/');
+    if (slash != std::string::npos && slash > 0) {
+        std::string dir = m_path.substr(0, slash);
+        for (std::string::size_type pos = 1; pos != std::string::npos; ) {
+            pos = dir.find('/', pos + 1);
+            ::mkdir(dir.substr(0, pos).c_str(), 0755);
+        }
+    }
+
+    uint64_t fileSize = 0;
+    m_fd = openPack(m_path, fileSize, error);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_end = sizeof(FILE_MAGIC);
+    bool ok;
+    {
+        Lock lock(m_fd);
+        ok = catchUp(error);
+    }
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+
+bool HistoryPack::catchUp(std::string *error)
+{
+    struct stat st;
+    if (::fstat(m_fd, &st) != 0) {
+        setError(error, FileUtil::errnoMessage("Cannot stat history pack " + m_path));
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+
+    // Index the records past m_end by walking their headers only
+    uint64_t offset = m_end;
+    while (offset + HEADER_SIZE <= fileSize) {
+        RecordHeader header;
+        std::string name;
+        if (!readHeader(offset, header, &name) || offset + header.recordSize() > fileSize) {
+            break;
+        }
+
+        HistoryVersion entry;
+        entry.version = header.version;
+        entry.timestamp = header.timestamp;
+        entry.offset = offset;
+        entry.size = header.contentSize;
+        m_index[name].push_back(entry);
+        m_depth[name] = header.kind == Keyframe ? 0 : m_depth[name] + 1;
+
+        offset += header.recordSize();
+    }
+
+    // Drop a torn tail so the next append starts on a record boundary
+    if (offset != fileSize && ::ftruncate(m_fd, static_cast<off_t>(offset)) != 0) {
+        setError(error, FileUtil::errnoMessage("Cannot repair history pack " + m_path));
+        return false;
+    }
+    m_end = offset;
+    return true;
+}
+
+bool HistoryPack::lockLatest(std::unique_ptr<Lock> &lock, std::string *error)
+{
+    for (;;) {
+        lock = std::make_unique<Lock>(m_fd);
+
+        // A compaction elsewhere renamed a new pack over ours: every later record
+        // would go to the unlinked file, so reopen and index the new one
+        struct stat held;
+        struct stat current;
+        if (::fstat(m_fd, &held) != 0 || ::stat(m_path.c_str(), &current) != 0
+            || held.st_ino != current.st_ino || held.st_dev != current.st_dev) {
+            lock.reset();
+            if (!open(error)) {
+                return false;
+            }
+            continue;
+        }
+
+        // Records other processes appended since we last looked
+        return catchUp(error);
+    }
+}
+
+bool HistoryPack::readHeader(uint64_t offset, RecordHeader &header, std::string *name) const
+{
+    unsigned char raw[HEADER_SIZE];
+    if (!preadAll(m_fd, raw, sizeof(raw), offset) || get32(raw) != RECORD_MAGIC) {
+        return false;
+    }
+
+    header.kind = raw[4];
+    header.flags = raw[5];
+    header.nameLength = get16(raw + 6);
+    header.version = get32(raw + 8);
+    header.contentSize = get32(raw + 12);
+    header.rawSize = get32(raw + 16);
+    header.storedSize = get32(raw + 20);
+    header.crc = get32(raw + 24);
+    header.timestamp = static_cast<int64_t>(get64(raw + 32));
+    header.baseOffset = get64(raw + 40);
+
+    if (header.kind != Keyframe && header.kind != Delta) {
+        return false;
+    }
+
+    if (name) {
+        name->resize(header.nameLength);
+        if (header.nameLength > 0
+            && !preadAll(m_fd, &(*name)[0], header.nameLength, offset + HEADER_SIZE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HistoryPack::loadAt(uint64_t offset, std::string &content, std::string *error) const
+{
+    TRACE_SCOPE("HistoryPack::load");
+    // Follow the delta chain back to its keyframe, then replay it forwards
+    std::vector<std::pair<RecordHeader, uint64_t>> chain;
+    for (;;) {
+        RecordHeader header;
+        if (chain.size() > KEYFRAME_INTERVAL || !readHeader(offset, header, nullptr)) {
+            setError(error, "Corrupt history record");
+            return false;
+        }
+        chain.emplace_back(header, offset);
+        if (header.kind == Keyframe) {
+            break;
+        }
+        offset = header.baseOffset;
+    }
+
+    content.clear();
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        const RecordHeader &header = it->first;
+
+        std::string stored(header.storedSize, '\0');
+        if (header.storedSize > 0
+            && !preadAll(m_fd, &stored[0], stored.size(), it->second + HEADER_SIZE + header.nameLength)) {
+            setError(error, FileUtil::errnoMessage("Cannot read history record"));
+            return false;
+        }
+
+        std::string payload;
+        if (header.flags & Deflated) {
+            payload.resize(header.rawSize);
+            uLongf length = header.rawSize;
+            if (::uncompress(reinterpret_cast<Bytef *>(&payload[0]), &length,
+                             reinterpret_cast<const Bytef *>(stored.data()), stored.size()) != Z_OK
+                || length != header.rawSize) {
+                setError(error, "Cannot inflate history record");
+                return false;
+            }
+        } else {
+            payload.swap(stored);
+        }
+
+        if (::crc32(0, reinterpret_cast<const Bytef *>(payload.data()), payload.size()) != header.crc) {
+            setError(error, "History record checksum mismatch");
+            return false;
+        }
+
+        if (header.kind == Keyframe) {
+            content.swap(payload);
+        } else {
+            std::string next;
+            if (!applyDelta(content, payload, next)) {
+                setError(error, "Corrupt history delta");
+                return false;
+            }
+            content.swap(next);
+        }
+    }
+
+    return true;
+}
+
+bool HistoryPack::appendRecord(int fd, uint64_t &end, const std::string &name, uint32_t version,
+                               int64_t timestamp, const std::string &base, uint64_t baseOffset,
+                               const std::string &content, std::string *error)
+{
+    RecordHeader header;
+    header.nameLength = static_cast<uint16_t>(name.size());
+    header.version = version;
+    header.contentSize = static_cast<uint32_t>(content.size());
+    header.timestamp = timestamp;
+
+    std::string payload;
+    if (baseOffset != 0) {
+        payload = makeDelta(base, content);
+        header.kind = Delta;
+        header.baseOffset = baseOffset;
+    }
+    if (baseOffset == 0 || payload.size() >= content.size()) {
+        payload = content;
+        header.kind = Keyframe;
+        header.baseOffset = 0;
+    }
+    header.rawSize = static_cast<uint32_t>(payload.size());
+    header.crc = ::crc32(0, reinterpret_cast<const Bytef *>(payload.data()), payload.size());
+
+    // Deflate only pays off for keyframes and large deltas
+    std::string stored;
+    uLongf bound = ::compressBound(payload.size());
+    stored.resize(bound);
+    if (::compress2(reinterpret_cast<Bytef *>(&stored[0]), &bound,
+                    reinterpret_cast<const Bytef *>(payload.data()), payload.size(),
+                    Z_BEST_COMPRESSION) == Z_OK
+        && bound < payload.size()) {
+        stored.resize(bound);
+        header.flags |= Deflated;
+    } else {
+        stored.swap(payload);
+    }
+    header.storedSize = static_cast<uint32_t>(stored.size());
+
+    std::string record(HEADER_SIZE, '\0');
+    unsigned char *raw = reinterpret_cast<unsigned char *>(&record[0]);
+    put32(raw, RECORD_MAGIC);
+    raw[4] = header.kind;
+    raw[5] = header.flags;
+    put16(raw + 6, header.nameLength);
+    put32(raw + 8, header.version);
+    put32(raw + 12, header.contentSize);
+    put32(raw + 16, header.rawSize);
+    put32(raw + 20, header.storedSize);
+    put32(raw + 24, header.crc);
+    put64(raw + 32, static_cast<uint64_t>(header.timestamp));
+    put64(raw + 40, header.baseOffset);
+    record += name;
+    record += stored;
+
+    if (!pwriteAll(fd, record.data(), record.size(), end) || ::fdatasync(fd) != 0) {
+        setError(error, FileUtil::errnoMessage("Cannot append to history pack"));
+        // Leave no torn record behind for the next append
+        if (::ftruncate(fd, static_cast<off_t>(end)) != 0) {
+            // open() repairs the tail if this fails too
+        }
+        return false;
+    }
+
+    end += record.size();
+    return true;
+}
+
+bool HistoryPack::append(const std::string &name, const std::string &content, std::string *error)
+{
+    TRACE_SCOPE("HistoryPack::append", name);
+    if (!isOpen()) {
+        setError(error, "History pack is not open");
+        return false;
+    }
+    if (name.empty() || name.size() > 0xffff) {
+        setError(error, "Invalid shortcut name for history");
+        return false;
+    }
+
+    std::unique_ptr<Lock> lock;
+    if (!lockLatest(lock, error)) {
+        return false;
+    }
+
+    std::vector<HistoryVersion> &entries = m_index[name];
+
+    std::string base;
+    uint64_t baseOffset = 0;
+    uint32_t version = 0;
+    if (!entries.empty()) {
+        const HistoryVersion &latest = entries.back();
+        if (!loadAt(latest.offset, base, error)) {
+            return false;
+        }
+        if (base == content) {
+            return true; // Nothing changed since the last save
+        }
+        version = latest.version + 1;
+
+        // Bound the delta chain so loading stays a fixed number of reads
+        if (m_depth[name] + 1 < KEYFRAME_INTERVAL) {
+            baseOffset = latest.offset;
+        }
+    }
+
+    HistoryVersion entry;
+    entry.version = version;
+    entry.timestamp = static_cast<int64_t>(std::time(nullptr));
+    entry.offset = m_end;
+    entry.size = static_cast<uint32_t>(content.size());
+
+    if (!appendRecord(m_fd, m_end, name, version, entry.timestamp, base, baseOffset, content, error)) {
+        if (entries.empty()) {
+            m_index.erase(name);
+        }
+        return false;
+    }
+
+    entries.push_back(entry);
+    m_depth[name] = baseOffset == 0 ? 0 : m_depth[name] + 1;
+    return true;
+}
+
+std::vector<HistoryVersion> HistoryPack::versions(const std::string &name) const
+{
+    auto it = m_index.find(name);
+    return it == m_index.end() ? std::vector<HistoryVersion>() : it->second;
+}
+
+std::vector<std::string> HistoryPack::names() const
+{
+    std::vector<std::string> result;
+    result.reserve(m_index.size());
+    for (const auto &entry : m_index) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+bool HistoryPack::load(const std::string &name, uint32_t version, std::string &content,
+                       std::string *error) const
+{
+    // Versions of a shortcut are numbered densely, so the index is positional
+    auto it = m_index.find(name);
+    if (it != m_index.end() && version >= it->second.front().version) {
+        const size_t position = version - it->second.front().version;
+        if (position < it->second.size() && it->second[position].version == version) {
+            return loadAt(it->second[position].offset, content, error);
+        }
+    }
+    setError(error, "No such version in history");
+    return false;
+}
+
+bool HistoryPack::compact(size_t keepVersions, std::string *error)
+{
+    if (!isOpen()) {
+        setError(error, "History pack is not open");
+        return false;
+    }
+
+    // Held until the new pack is in place; writers waiting on the old one then
+    // notice it was replaced and reopen
+    std::unique_ptr<Lock> lock;
+    if (!lockLatest(lock, error)) {
+        return false;
+    }
+
+    std::string tempPath = m_path + ".compact";
+    ::unlink(tempPath.c_str());
+
+    uint64_t end = 0;
+    int fd = openPack(tempPath, end, error);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = true;
+    for (const auto &entry : m_index) {
+        const std::vector<HistoryVersion> &entries = entry.second;
+        size_t first = (keepVersions > 0 && entries.size() > keepVersions)
+                     ? entries.size() - keepVersions : 0;
+
+        std::string base;
+        uint64_t baseOffset = 0;
+        uint32_t depth = 0;
+        for (size_t i = first; ok && i < entries.size(); ++i) {
+            std::string content;
+            ok = loadAt(entries[i].offset, content, error);
+            if (!ok) {
+                break;
+            }
+
+            uint64_t offset = end;
+            if (depth % KEYFRAME_INTERVAL == 0) {
+                baseOffset = 0;
+            }
+            ok = appendRecord(fd, end, entry.first, entries[i].version, entries[i].timestamp,
+                              base, baseOffset, content, error);
+            base.swap(content);
+            baseOffset = offset;
+            ++depth;
+        }
+        if (!ok) {
+            break;
+        }
+    }
+
+    if (ok && (::fsync(fd) != 0 || ::rename(tempPath.c_str(), m_path.c_str()) != 0)) {
+        setError(error, FileUtil::errnoMessage("Cannot replace history pack " + m_path));
+        ok = false;
+    }
+    ::close(fd);
+
+    if (!ok) {
+        ::unlink(tempPath.c_str());
+        return false;
+    }
+
+    lock.reset();
+    return open(error);
+}
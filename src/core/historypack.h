@@ -0,0 +1,85 @@
+#ifndef HISTORYPACK_H
+#define HISTORYPACK_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One saved version of a shortcut script
+struct HistoryVersion {
+    uint32_t version = 0;   // 0 for the first save, counting up
+    int64_t timestamp = 0;  // seconds since the epoch
+    uint64_t offset = 0;    // record position in the pack
+    uint32_t size = 0;      // size of the full script
+};
+
+// Append-only pack holding every saved version of every shortcut.
+//
+// Each record stores either a keyframe (the full script) or a delta against the
+// previous version of the same shortcut, deflated when that makes it smaller. A
+// keyframe is forced every KEYFRAME_INTERVAL versions so any version is rebuilt
+// from at most that many records, and the per-shortcut offset index built on
+// open() makes locating it a lookup. A torn record at the tail (e.g. after a
+// crash mid-save) is discarded on open.
+//
+// Several processes may share the pack: appends and compaction hold an
+// exclusive flock(), pick up records others appended first, and reopen the pack
+// if a compaction replaced it.
+class HistoryPack
+{
+public:
+    static constexpr const char *DEFAULT_PATH = "/var/lib/shorts/history.pack";
+    static constexpr uint32_t KEYFRAME_INTERVAL = 16;
+
+    explicit HistoryPack(std::string path = DEFAULT_PATH);
+    ~HistoryPack();
+
+    HistoryPack(const HistoryPack &) = delete;
+    HistoryPack &operator=(const HistoryPack &) = delete;
+
+    // Open (creating if needed) the pack and index its records
+    bool open(std::string *error = nullptr);
+    bool isOpen() const { return m_fd >= 0; }
+    void close();
+
+    const std::string &path() const { return m_path; }
+    uint64_t size() const { return m_end; }
+
+    // Record content as the newest version of name. Saving the same content
+    // as the newest version again is a no-op.
+    bool append(const std::string &name, const std::string &content, std::string *error = nullptr);
+
+    // All versions of name, oldest first
+    std::vector<HistoryVersion> versions(const std::string &name) const;
+    std::vector<std::string> names() const;
+
+    bool load(const std::string &name, uint32_t version, std::string &content,
+              std::string *error = nullptr) const;
+
+    // Rewrite the pack with each shortcut's versions stored contiguously, keeping
+    // only the newest keepVersions per shortcut (0 keeps all). The new pack replaces
+    // the old one atomically; open instances reopen it before their next append.
+    bool compact(size_t keepVersions = 0, std::string *error = nullptr);
+
+private:
+    struct RecordHeader;
+    class Lock;
+
+    bool catchUp(std::string *error);
+    bool lockLatest(std::unique_ptr<Lock> &lock, std::string *error);
+    bool readHeader(uint64_t offset, RecordHeader &header, std::string *name) const;
+    bool loadAt(uint64_t offset, std::string &content, std::string *error) const;
+    bool appendRecord(int fd, uint64_t &end, const std::string &name, uint32_t version,
+                      int64_t timestamp, const std::string &base, uint64_t baseOffset,
+                      const std::string &content, std::string *error);
+
+    std::string m_path;
+    int m_fd = -1;
+    uint64_t m_end = 0;
+    std::map<std::string, std::vector<HistoryVersion>> m_index;
+    std::map<std::string, uint32_t> m_depth; // deltas since the newest keyframe
+};
+
+#endif // HISTORYPACK_H
@@ -0,0 +1,103 @@
+#include "memorystore.h"
+
+#include <ctime>
+#include <mutex>
+
+ShortcutStore::Entry MemoryStore::entryOf(const std::string &name, const File &file)
+{
+    Entry entry;
+    entry.name = name;
+    entry.info.size = file.content->size();
+    entry.info.modified = file.modified;
+    FileClassifier::examine(*file.content, entry.info);
+    return entry;
+}
+
+bool MemoryStore::exists(const std::string &name) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_files.count(name) > 0;
+}
+
+std::vector<std::string> MemoryStore::list() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<std::string> names;
+    names.reserve(m_files.size());
+    for (const auto &file : m_files) {
+        names.push_back(file.first);
+    }
+    return names;
+}
+
+std::vector<ShortcutStore::Entry> MemoryStore::entries() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<Entry> result;
+    result.reserve(m_files.size());
+    for (const auto &file : m_files) {
+        result.push_back(entryOf(file.first, file.second));
+    }
+    return result;
+}
+
+bool MemoryStore::inspect(const std::string &name, FileClassifier::Info &info, std::string *error) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_files.find(name);
+    if (it == m_files.end()) {
+        if (error) {
+            *error = "No such shortcut: " + path(name);
+        }
+        return false;
+    }
+    info = entryOf(name, it->second).info;
+    return true;
+}
+
+bool MemoryStore::map(const std::string &name, Contents &contents, std::string *error) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_files.find(name);
+    if (it == m_files.end()) {
+        if (error) {
+            *error = "No such shortcut: " + path(name);
+        }
+        return false;
+    }
+    // Shares the string; a later write swaps in a new one and leaves this alone
+    const std::shared_ptr<const std::string> &content = it->second.content;
+    contents = Contents(content, *content);
+    return true;
+}
+
+bool MemoryStore::applyBatch(const std::vector<Operation> &operations, std::string *error)
+{
+    if (operations.empty()) {
+        return true;
+    }
+    if (!validate(operations, error)) {
+        return false;
+    }
+
+    // Copy the new contents before taking the lock, so readers wait only for the
+    // map updates
+    std::vector<std::shared_ptr<const std::string>> contents(operations.size());
+    for (size_t i = 0; i < operations.size(); ++i) {
+        if (operations[i].type == Operation::Write) {
+            contents[i] = std::make_shared<const std::string>(operations[i].content);
+        }
+    }
+    const time_t now = std::time(nullptr);
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (size_t i = 0; i < operations.size(); ++i) {
+        if (operations[i].type == Operation::Write) {
+            m_files[operations[i].name] = File{std::move(contents[i]), now};
+        } else {
+            m_files.erase(operations[i].name);
+        }
+    }
+    ++m_version;
+    return true;
+}
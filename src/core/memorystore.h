@@ -0,0 +1,44 @@
+#ifndef MEMORYSTORE_H
+#define MEMORYSTORE_H
+
+#include "shortcutstore.h"
+
+#include <atomic>
+#include <map>
+#include <shared_mutex>
+
+// Shortcuts held in memory, with no file system access at all. For tests and
+// benchmarks that exercise the front end or the engine without a directory.
+class MemoryStore : public ShortcutStore
+{
+public:
+    MemoryStore() = default;
+
+    std::string location() const override { return "(memory)"; }
+    std::string directory() const override { return std::string(); }
+    std::string path(const std::string &name) const override { return "memory:" + name; }
+
+    bool available() const override { return true; }
+    bool exists(const std::string &name) const override;
+    std::vector<std::string> list() const override;
+    std::vector<Entry> entries() const override;
+    bool inspect(const std::string &name, FileClassifier::Info &info, std::string *error = nullptr) const override;
+    bool map(const std::string &name, Contents &contents, std::string *error = nullptr) const override;
+    bool applyBatch(const std::vector<Operation> &operations, std::string *error = nullptr) override;
+
+    // Counts applied batches
+    uint64_t version() const override { return m_version.load(); }
+
+private:
+    struct File {
+        std::shared_ptr<const std::string> content;
+        time_t modified = 0;
+    };
+    static Entry entryOf(const std::string &name, const File &file);
+
+    mutable std::shared_mutex m_mutex;
+    std::map<std::string, File> m_files;
+    std::atomic<uint64_t> m_version{0};
+};
+
+#endif // MEMORYSTORE_H
@@ -0,0 +1,116 @@
+#include "overlaystore.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sys/stat.h>
+
+OverlayStore::OverlayStore(std::string userDirectory, std::string systemDirectory)
+    : m_user(std::move(userDirectory))
+    , m_system(std::move(systemDirectory))
+{
+}
+
+std::string OverlayStore::location() const
+{
+    return m_user.directory() + " over " + m_system.directory();
+}
+
+const DirectoryStore &OverlayStore::layerOf(const std::string &name) const
+{
+    return m_user.exists(name) || !m_system.exists(name) ? m_user : m_system;
+}
+
+std::string OverlayStore::path(const std::string &name) const
+{
+    return layerOf(name).path(name);
+}
+
+bool OverlayStore::exists(const std::string &name) const
+{
+    return m_user.exists(name) || m_system.exists(name);
+}
+
+bool OverlayStore::isSystem(const std::string &name) const
+{
+    return &layerOf(name) == &m_system;
+}
+
+std::vector<std::string> OverlayStore::list() const
+{
+    TRACE_SCOPE("OverlayStore::list");
+    std::vector<std::string> user = m_user.list();
+    std::vector<std::string> system = m_system.list();
+    std::vector<std::string> names;
+    names.reserve(user.size() + system.size());
+    std::set_union(user.begin(), user.end(), system.begin(), system.end(), std::back_inserter(names));
+    return names;
+}
+
+std::vector<ShortcutStore::Entry> OverlayStore::entries() const
+{
+    TRACE_SCOPE("OverlayStore::entries");
+    std::vector<Entry> user = m_user.entries();
+    std::vector<Entry> system = m_system.entries();
+
+    // Both are sorted by name; on a tie the user's entry wins
+    std::vector<Entry> result;
+    result.reserve(user.size() + system.size());
+    auto u = user.begin();
+    auto s = system.begin();
+    while (u != user.end() || s != system.end()) {
+        if (s == system.end() || (u != user.end() && u->name <= s->name)) {
+            if (s != system.end() && u->name == s->name) {
+                ++s;
+            }
+            result.push_back(std::move(*u++));
+        } else {
+            result.push_back(std::move(*s++));
+        }
+    }
+    return result;
+}
+
+bool OverlayStore::inspect(const std::string &name, FileClassifier::Info &info, std::string *error) const
+{
+    return layerOf(name).inspect(name, info, error);
+}
+
+bool OverlayStore::map(const std::string &name, Contents &contents, std::string *error) const
+{
+    return layerOf(name).map(name, contents, error);
+}
+
+bool OverlayStore::applyBatch(const std::vector<Operation> &operations, std::string *error)
+{
+    TRACE_SCOPE("OverlayStore::applyBatch");
+    if (operations.empty()) {
+        return true;
+    }
+    if (!validate(operations, error)) {
+        return false;
+    }
+    for (const Operation &operation : operations) {
+        if (operation.type == Operation::Remove && !m_user.exists(operation.name)
+            && m_system.exists(operation.name)) {
+            if (error) {
+                *error = operation.name + " is provided by " + m_system.directory() + " and cannot be removed";
+            }
+            return false;
+        }
+    }
+
+    // Create the user directory and its parents on the first write
+    const std::string dir = m_user.directory();
+    for (std::string::size_type pos = 1; !m_user.available() && pos != std::string::npos; ) {
+        pos = dir.find('/', pos + 1);
+        ::mkdir(dir.substr(0, pos).c_str(), 0755);
+    }
+    return m_user.applyBatch(operations, error);
+}
+
+uint64_t OverlayStore::version() const
+{
+    // Either layer changing changes the result
+    return m_user.version() * 1000003u ^ m_system.version();
+}
@@ -0,0 +1,39 @@
+#ifndef OVERLAYSTORE_H
+#define OVERLAYSTORE_H
+
+#include "directorystore.h"
+
+// A writable user directory layered over a read-only system one. Reads and
+// listings see the union, with the user's copy hiding a system shortcut of the
+// same name; writes always go to the user directory, which is created on the
+// first write. Removing a user copy uncovers the system shortcut again, and a
+// shortcut only the system directory provides cannot be removed.
+class OverlayStore : public ShortcutStore
+{
+public:
+    OverlayStore(std::string userDirectory, std::string systemDirectory = DirectoryStore::SHORTCUT_DIR);
+
+    std::string location() const override;
+    std::string directory() const override { return m_user.directory(); }
+    std::string path(const std::string &name) const override;
+
+    bool available() const override { return m_user.available() || m_system.available(); }
+    bool exists(const std::string &name) const override;
+    std::vector<std::string> list() const override;
+    std::vector<Entry> entries() const override;
+    bool inspect(const std::string &name, FileClassifier::Info &info, std::string *error = nullptr) const override;
+    bool map(const std::string &name, Contents &contents, std::string *error = nullptr) const override;
+    bool applyBatch(const std::vector<Operation> &operations, std::string *error = nullptr) override;
+    uint64_t version() const override;
+
+    // Whether name comes from the system directory
+    bool isSystem(const std::string &name) const;
+
+private:
+    const DirectoryStore &layerOf(const std::string &name) const;
+
+    DirectoryStore m_user;
+    DirectoryStore m_system;
+};
+
+#endif // OVERLAYSTORE_H
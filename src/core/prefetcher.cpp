@@ -0,0 +1,121 @@
+#include "prefetcher.h"
+#include "shortcutparser.h"
+#include "shortcutstore.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+Prefetcher::Prefetcher(const ShortcutStore &store, size_t capacity)
+    : m_store(store)
+    , m_cache(capacity)
+{
+    m_worker = std::thread(&Prefetcher::run, this);
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_pending.clear();
+    }
+    m_wakeUp.notify_all();
+    m_worker.join();
+}
+
+void Prefetcher::prefetch(const std::vector<std::string> &names)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Older requests are for a selection the user has already moved away from
+        m_pending.clear();
+        for (const std::string &name : names) {
+            if (!m_cache.contains(name)) {
+                m_pending.push_back(name);
+            }
+        }
+    }
+    m_wakeUp.notify_one();
+}
+
+bool Prefetcher::load(const std::string &name, Shortcut &shortcut, std::string *error) const
+{
+    TRACE_SCOPE("Prefetcher::load", name);
+    ShortcutStore::Contents contents;
+    if (!m_store.map(name, contents, error)) {
+        return false;
+    }
+    shortcut = ShortcutParser::parse(contents.view());
+    shortcut.name = name;
+    return true;
+}
+
+bool Prefetcher::get(const std::string &name, Shortcut &shortcut, std::string *error)
+{
+    if (m_cache.lookup(name, shortcut)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.hits;
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t generation = m_cache.generation();
+    bool ok = load(name, shortcut, error);
+    if (ok) {
+        m_cache.insert(shortcut, generation);
+    }
+    uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.misses;
+    m_stats.totalMissNs += elapsed;
+    m_stats.maxMissNs = std::max(m_stats.maxMissNs, elapsed);
+    return ok;
+}
+
+void Prefetcher::invalidate(const std::string &name)
+{
+    m_cache.invalidate(name);
+}
+
+void Prefetcher::clear()
+{
+    m_cache.clear();
+}
+
+Prefetcher::Stats Prefetcher::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Prefetcher::run()
+{
+    Trace::setThreadName("prefetch");
+    for (;;) {
+        std::string name;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            name = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+
+        if (m_cache.contains(name)) {
+            continue;
+        }
+
+        uint64_t generation = m_cache.generation();
+        Shortcut shortcut;
+        if (load(name, shortcut, nullptr)) {
+            m_cache.insert(shortcut, generation);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.prefetched;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include "shortcutcache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ShortcutStore;
+
+// Loads and parses shortcuts on a background thread so that selecting one in the
+// list is a cache hit. The front end calls prefetch() with the names around the
+// selection and in the viewport; get() serves from the cache or loads
+// synchronously on a miss.
+class Prefetcher
+{
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t prefetched = 0;
+        uint64_t totalMissNs = 0;
+        uint64_t maxMissNs = 0;
+
+        double hitRate() const
+        {
+            uint64_t total = hits + misses;
+            return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+        }
+        double averageMissMs() const
+        {
+            return misses == 0 ? 0.0 : static_cast<double>(totalMissNs) / misses / 1e6;
+        }
+    };
+
+    explicit Prefetcher(const ShortcutStore &store, size_t capacity = 256);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher &) = delete;
+    Prefetcher &operator=(const Prefetcher &) = delete;
+
+    // Replace the pending work with names, most wanted first
+    void prefetch(const std::vector<std::string> &names);
+
+    // Parsed shortcut for name, from the cache when possible
+    bool get(const std::string &name, Shortcut &shortcut, std::string *error = nullptr);
+
+    // Forget name after it was written or removed
+    void invalidate(const std::string &name);
+    void clear();
+
+    Stats stats() const;
+
+private:
+    bool load(const std::string &name, Shortcut &shortcut, std::string *error) const;
+    void run();
+
+    const ShortcutStore &m_store;
+    ShortcutCache m_cache;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<std::string> m_pending;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    std::thread m_worker;
+};
+
+#endif // PREFETCHER_H
@@ -0,0 +1,106 @@
+#include "privilegedhelper.h"
+#include "fileutil.h"
+#include "trace.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+bool PrivilegedHelper::runScript(const std::string &script, int timeoutMs, std::string *error)
+{
+    TRACE_SCOPE("pkexec round-trip");
+    std::string scriptPath;
+    if (!FileUtil::writeTemp("shortcut_install_", "#!/bin/bash\n" + script, 0755, scriptPath, error)) {
+        return false;
+    }
+
+    int errPipe[2];
+    if (::pipe2(errPipe, O_CLOEXEC) != 0) {
+        if (error) {
+            *error = FileUtil::errnoMessage("Failed to create pipe");
+        }
+        ::unlink(scriptPath.c_str());
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    const char *argv[] = {"pkexec", "--disable-internal-agent", scriptPath.c_str(), nullptr};
+    pid_t pid = 0;
+    int rc = posix_spawnp(&pid, "pkexec", &actions, nullptr,
+                          const_cast<char *const *>(argv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(errPipe[1]);
+
+    if (rc != 0) {
+        errno = rc;
+        if (error) {
+            *error = FileUtil::errnoMessage("Failed to start pkexec");
+        }
+        ::close(errPipe[0]);
+        ::unlink(scriptPath.c_str());
+        return false;
+    }
+
+    // Collect stderr until the helper exits or the timeout expires
+    std::string errorOutput;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    bool timedOut = false;
+    for (;;) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            timedOut = true;
+            break;
+        }
+
+        struct pollfd pfd = {errPipe[0], POLLIN, 0};
+        int ready = ::poll(&pfd, 1, static_cast<int>(remaining));
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready > 0) {
+            char buffer[512];
+            ssize_t n = ::read(errPipe[0], buffer, sizeof(buffer));
+            if (n <= 0) {
+                break; // EOF: the helper closed stderr
+            }
+            errorOutput.append(buffer, static_cast<size_t>(n));
+        }
+    }
+    ::close(errPipe[0]);
+
+    if (timedOut) {
+        ::kill(pid, SIGTERM);
+    }
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    ::unlink(scriptPath.c_str());
+
+    if (timedOut) {
+        if (error) {
+            *error = "Timeout while waiting for root privileges";
+        }
+        return false;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (error) {
+            *error = errorOutput.empty() ? std::string("Privileged helper failed") : errorOutput;
+        }
+        return false;
+    }
+
+    return true;
+}
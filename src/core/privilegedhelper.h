@@ -0,0 +1,16 @@
+#ifndef PRIVILEGEDHELPER_H
+#define PRIVILEGEDHELPER_H
+
+#include <string>
+
+// Runs shell snippets as root through pkexec, used when the shortcut directory is
+// not writable by the current process
+class PrivilegedHelper
+{
+public:
+    // Write script to a temporary file and execute it with pkexec. Returns true when
+    // the script exits with status 0 within timeoutMs; otherwise error describes why.
+    static bool runScript(const std::string &script, int timeoutMs, std::string *error = nullptr);
+};
+
+#endif // PRIVILEGEDHELPER_H
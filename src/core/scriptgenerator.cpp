@@ -0,0 +1,110 @@
+#include "scriptgenerator.h"
+#include "stringutil.h"
+#include "trace.h"
+
+const char *ScriptGenerator::banner()
+{
+    return "# Shortcut created with Shorts -- Shortcut Manager Gui\n"
+           "# Created by 0hex01 (Michael McClure)\n"
+           "# Feel free to copy, manipulate, and distribute Shorts and shortcuts created with shorts\n"
+           "# This shortcut comes with no Guarantees or Warranties, use at your own risk\n"
+           "# shortcut command is below this line\n";
+}
+
+std::string ScriptGenerator::commandLine(const std::string &command, const CommandOptions &options)
+{
+    std::string line;
+
+    // Add nohup if background mode is enabled
+    if (options.runInBackground) {
+        line += "nohup ";
+    }
+
+    // Only add sudo if requested and the command doesn't already have sudo
+    if (options.useSudo && command.find("sudo ") == std::string::npos) {
+        line += "sudo ";
+    }
+
+    // Add the command exactly as entered
+    line += command;
+
+    if (options.openEnded) {
+        line += " $@";
+    }
+
+    if (options.runInBackground) {
+        line += " &";
+    }
+
+    return line;
+}
+
+std::string ScriptGenerator::script(const std::string &command, const CommandOptions &options)
+{
+    TRACE_SCOPE("ScriptGenerator::script");
+    return scriptForLine(commandLine(command, options));
+}
+
+std::string ScriptGenerator::scriptForLine(const std::string &line)
+{
+    std::string content = "#!/bin/bash\n";
+    content += banner();
+    content += "\n";
+    content += line;
+    content += "\n";
+    return content;
+}
+
+std::string ScriptGenerator::flattenedScript(const std::string &source, const std::string &body)
+{
+    if (body == source) {
+        return scriptForLine(source);
+    }
+
+    std::string content = "#!/bin/bash\n";
+    content += banner();
+    content += "\n";
+    content += FLATTENED_MARKER;
+    content += source;
+    content += "\n";
+    content += body;
+    content += "\n";
+    return content;
+}
+
+std::string ScriptGenerator::preview(const std::string &command, const CommandOptions &options)
+{
+    std::string trimmed = StringUtil::trimmed(command);
+    if (trimmed.empty()) {
+        return std::string();
+    }
+
+    // A command that starts with sudo implies the sudo option
+    bool useSudo = options.useSudo;
+    if (StringUtil::startsWith(trimmed, "sudo ")) {
+        useSudo = true;
+        trimmed = StringUtil::trimmed(trimmed.substr(5));
+    }
+
+    std::string preview;
+
+    if (useSudo) {
+        preview += "sudo ";
+    }
+
+    if (options.runInBackground) {
+        preview += "nohup ";
+    }
+
+    preview += trimmed;
+
+    if (options.openEnded) {
+        preview += " $@";
+    }
+
+    if (options.runInBackground) {
+        preview += " &";
+    }
+
+    return preview;
+}
@@ -0,0 +1,35 @@
+#ifndef SCRIPTGENERATOR_H
+#define SCRIPTGENERATOR_H
+
+#include "shortcut.h"
+
+#include <string>
+
+class ScriptGenerator
+{
+public:
+    // Full script as written to disk: shebang, Shorts banner and the command line
+    static std::string script(const std::string &command, const CommandOptions &options);
+
+    // The single command line that follows the banner
+    static std::string commandLine(const std::string &command, const CommandOptions &options);
+
+    // Script for a command line that already carries its options
+    static std::string scriptForLine(const std::string &line);
+
+    // Script that runs body, a flattened equivalent of source (see ShortcutGraph).
+    // source is kept in a FLATTENED_MARKER comment, which ShortcutParser reads in
+    // place of body so editing still shows what the user wrote.
+    static std::string flattenedScript(const std::string &source, const std::string &body);
+
+    static constexpr const char *FLATTENED_MARKER = "# Flattened from: ";
+
+    // What the user sees in the preview field. A leading "sudo " in the command is
+    // folded into the sudo option, so the preview never shows it twice.
+    static std::string preview(const std::string &command, const CommandOptions &options);
+
+    // The comment block written after the shebang
+    static const char *banner();
+};
+
+#endif // SCRIPTGENERATOR_H
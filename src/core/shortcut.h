@@ -0,0 +1,20 @@
+#ifndef SHORTCUT_H
+#define SHORTCUT_H
+
+#include <string>
+
+// Flags that decorate the command written into a shortcut script
+struct CommandOptions {
+    bool useSudo = false;
+    bool runInBackground = false;
+    bool openEnded = false;
+};
+
+// A shortcut as the user edits it: its name, the bare command and its options
+struct Shortcut {
+    std::string name;
+    std::string command;
+    CommandOptions options;
+};
+
+#endif // SHORTCUT_H
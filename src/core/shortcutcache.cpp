@@ -0,0 +1,80 @@
+#include "shortcutcache.h"
+
+ShortcutCache::ShortcutCache(size_t capacity)
+    : m_capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+bool ShortcutCache::lookup(const std::string &name, Shortcut &shortcut)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_lookup.find(name);
+    if (it == m_lookup.end()) {
+        return false;
+    }
+
+    // Move to the front as the most recently used
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    shortcut = *it->second;
+    return true;
+}
+
+bool ShortcutCache::contains(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lookup.count(name) > 0;
+}
+
+void ShortcutCache::insert(const Shortcut &shortcut, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation != m_generation) {
+        return; // Loaded before an invalidation; the data may be stale
+    }
+
+    auto it = m_lookup.find(shortcut.name);
+    if (it != m_lookup.end()) {
+        *it->second = shortcut;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+
+    m_entries.push_front(shortcut);
+    m_lookup[shortcut.name] = m_entries.begin();
+
+    if (m_entries.size() > m_capacity) {
+        m_lookup.erase(m_entries.back().name);
+        m_entries.pop_back();
+    }
+}
+
+void ShortcutCache::invalidate(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    auto it = m_lookup.find(name);
+    if (it != m_lookup.end()) {
+        m_entries.erase(it->second);
+        m_lookup.erase(it);
+    }
+}
+
+void ShortcutCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    m_entries.clear();
+    m_lookup.clear();
+}
+
+uint64_t ShortcutCache::generation() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
+
+size_t ShortcutCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
@@ -0,0 +1,43 @@
+#ifndef SHORTCUTCACHE_H
+#define SHORTCUTCACHE_H
+
+#include "shortcut.h"
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Bounded, thread-safe LRU of parsed shortcuts keyed by name.
+//
+// Every invalidation bumps a generation counter. A loader that snapshots the
+// generation before reading a file and passes it to insert() can never put back
+// an entry that was invalidated while it was reading.
+class ShortcutCache
+{
+public:
+    explicit ShortcutCache(size_t capacity = 256);
+
+    bool lookup(const std::string &name, Shortcut &shortcut);
+    bool contains(const std::string &name) const;
+    void insert(const Shortcut &shortcut, uint64_t generation);
+
+    void invalidate(const std::string &name);
+    void clear();
+
+    uint64_t generation() const;
+    size_t size() const;
+    size_t capacity() const { return m_capacity; }
+
+private:
+    using Entries = std::list<Shortcut>;
+
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    uint64_t m_generation = 0;
+    Entries m_entries; // most recently used first
+    std::unordered_map<std::string, Entries::iterator> m_lookup;
+};
+
+#endif // SHORTCUTCACHE_H
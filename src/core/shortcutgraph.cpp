@@ -0,0 +1,472 @@
+#include "shortcutgraph.h"
+#include "scriptgenerator.h"
+#include "stringutil.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// One simple command inside a command line
+struct Invocation {
+    size_t begin = 0;     // start of the command word
+    size_t wordEnd = 0;   // end of the command word
+    size_t end = 0;       // end of the arguments, trailing blanks excluded
+    bool elevated = false; // run through a leading sudo
+};
+
+bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// End of the shell word starting at pos, honouring quotes and backslashes
+size_t wordEnd(std::string_view s, size_t pos)
+{
+    char quote = 0;
+    while (pos < s.size()) {
+        char c = s[pos];
+        if (quote) {
+            if (c == '\\' && quote == '"') {
+                ++pos;
+            } else if (c == quote) {
+                quote = 0;
+            }
+        } else if (isBlank(c)) {
+            break;
+        } else if (c == '\\') {
+            ++pos;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        }
+        ++pos;
+    }
+    return std::min(pos, s.size());
+}
+
+bool isAssignment(std::string_view word)
+{
+    size_t eq = word.find('=');
+    if (eq == 0 || eq == std::string_view::npos) {
+        return false;
+    }
+    for (size_t i = 0; i < eq; ++i) {
+        char c = word[i];
+        bool ok = c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                  || (i > 0 && c >= '0' && c <= '9');
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Split line at unquoted control operators, subshells and substitutions, and
+// locate the command word of each simple command. Calls inside double-quoted
+// substitutions are not looked at.
+std::vector<Invocation> invocations(std::string_view line)
+{
+    std::vector<std::pair<size_t, size_t>> segments;
+    size_t start = 0;
+    char quote = 0;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quote) {
+            if (c == '\\' && quote == '"') {
+                ++i;
+            } else if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '\\') {
+            ++i;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == ';' || c == '&' || c == '|' || c == '(' || c == ')' || c == '`' || c == '\n') {
+            segments.emplace_back(start, i);
+            start = i + 1;
+        } else if (c == '$' && i + 1 < line.size() && line[i + 1] == '(') {
+            segments.emplace_back(start, i);
+            start = i + 2;
+            ++i;
+        }
+    }
+    segments.emplace_back(start, line.size());
+
+    std::vector<Invocation> result;
+    for (const auto &segment : segments) {
+        size_t end = segment.second;
+        while (end > segment.first && StringUtil::isSpace(line[end - 1])) {
+            --end;
+        }
+
+        Invocation invocation;
+        size_t pos = segment.first;
+        for (;;) {
+            while (pos < end && isBlank(line[pos])) {
+                ++pos;
+            }
+            if (pos >= end) {
+                break;
+            }
+            size_t wordStop = std::min(wordEnd(line, pos), end);
+            std::string_view word = line.substr(pos, wordStop - pos);
+
+            // Prefixes that still run the next word as the command
+            if (word == "sudo") {
+                invocation.elevated = true;
+            } else if (!(word == "nohup" || word == "exec" || word == "command" || word == "time"
+                         || isAssignment(word))) {
+                invocation.begin = pos;
+                invocation.wordEnd = wordStop;
+                invocation.end = end;
+                result.push_back(invocation);
+                break;
+            }
+            pos = wordStop;
+        }
+    }
+    return result;
+}
+
+// Builtins and reserved words act on the shell running them (exec replaces it,
+// exit and return end it, cd and export change its state), so a body that runs
+// one cannot be pasted into another command line
+bool isShellBuiltin(std::string_view word)
+{
+    static constexpr std::string_view BUILTINS[] = {
+        "!", ".", ":", "[", "[[", "]]", "{", "}", "alias", "bg", "bind", "break", "builtin",
+        "caller", "case", "cd", "command", "compgen", "complete", "compopt", "continue",
+        "coproc", "declare", "dirs", "disown", "do", "done", "echo", "elif", "else", "enable",
+        "esac", "eval", "exec", "exit", "export", "false", "fc", "fg", "fi", "for", "function",
+        "getopts", "hash", "help", "history", "if", "in", "jobs", "kill", "let", "local",
+        "logout", "mapfile", "popd", "printf", "pushd", "pwd", "read", "readarray", "readonly",
+        "return", "select", "set", "shift", "shopt", "source", "suspend", "test", "then",
+        "time", "times", "trap", "true", "type", "typeset", "ulimit", "umask", "unalias",
+        "unset", "until", "wait", "while",
+    };
+    return std::find(std::begin(BUILTINS), std::end(BUILTINS), word) != std::end(BUILTINS);
+}
+
+// Remove a trailing $@ or "$@"; returns whether there was one
+bool stripForwardedArguments(std::string &line)
+{
+    for (std::string_view suffix : {std::string_view(" \"$@\""), std::string_view(" $@")}) {
+        if (StringUtil::endsWith(line, suffix)) {
+            line.resize(line.size() - suffix.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void ShortcutGraph::build(const std::vector<Shortcut> &shortcuts, const std::string &directory)
+{
+    TRACE_SCOPE("ShortcutGraph::build");
+    m_directory = directory;
+    m_lines.clear();
+    for (const Shortcut &shortcut : shortcuts) {
+        if (!shortcut.command.empty()) {
+            m_lines[shortcut.name] = shortcut.command;
+        }
+    }
+    index();
+}
+
+void ShortcutGraph::insert(const Shortcut &shortcut)
+{
+    m_lines[shortcut.name] = shortcut.command;
+    index();
+}
+
+void ShortcutGraph::remove(const std::string &name)
+{
+    if (m_lines.erase(name) > 0) {
+        index();
+    }
+}
+
+std::string ShortcutGraph::resolve(std::string_view word) const
+{
+    if (!m_directory.empty() && word.size() > m_directory.size() + 1
+        && StringUtil::startsWith(word, m_directory) && word[m_directory.size()] == '/') {
+        word.remove_prefix(m_directory.size() + 1);
+    }
+    std::string name(word);
+    return m_lines.count(name) ? name : std::string();
+}
+
+void ShortcutGraph::index()
+{
+    m_callees.clear();
+    m_callers.clear();
+    m_cyclic.clear();
+    m_cycles.clear();
+
+    for (const auto &entry : m_lines) {
+        std::vector<std::string> &callees = m_callees[entry.first];
+        for (const Invocation &invocation : invocations(entry.second)) {
+            std::string callee = resolve(std::string_view(entry.second).substr(
+                invocation.begin, invocation.wordEnd - invocation.begin));
+            if (!callee.empty()) {
+                callees.push_back(callee);
+            }
+        }
+        std::sort(callees.begin(), callees.end());
+        callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+        for (const std::string &callee : callees) {
+            m_callers[callee].push_back(entry.first);
+        }
+    }
+
+    // Tarjan's strongly connected components; a component of more than one
+    // shortcut, or one that calls itself, is a cycle
+    std::map<std::string, int> order;
+    std::map<std::string, int> low;
+    std::vector<std::string> stack;
+    std::set<std::string> onStack;
+    int counter = 0;
+
+    std::function<void(const std::string &)> connect = [&](const std::string &name) {
+        order[name] = low[name] = counter++;
+        stack.push_back(name);
+        onStack.insert(name);
+
+        for (const std::string &callee : m_callees[name]) {
+            if (!order.count(callee)) {
+                connect(callee);
+                low[name] = std::min(low[name], low[callee]);
+            } else if (onStack.count(callee)) {
+                low[name] = std::min(low[name], order[callee]);
+            }
+        }
+
+        if (low[name] != order[name]) {
+            return;
+        }
+        std::vector<std::string> component;
+        std::string member;
+        do {
+            member = stack.back();
+            stack.pop_back();
+            onStack.erase(member);
+            component.push_back(member);
+        } while (member != name);
+
+        const std::vector<std::string> &own = m_callees[name];
+        if (component.size() > 1 || std::binary_search(own.begin(), own.end(), name)) {
+            std::sort(component.begin(), component.end());
+            m_cyclic.insert(component.begin(), component.end());
+            m_cycles.push_back(component);
+        }
+    };
+
+    for (const auto &entry : m_lines) {
+        if (!order.count(entry.first)) {
+            connect(entry.first);
+        }
+    }
+    std::sort(m_cycles.begin(), m_cycles.end());
+}
+
+std::vector<std::string> ShortcutGraph::names() const
+{
+    std::vector<std::string> result;
+    result.reserve(m_lines.size());
+    for (const auto &entry : m_lines) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+std::vector<std::string> ShortcutGraph::callees(const std::string &name) const
+{
+    auto it = m_callees.find(name);
+    return it == m_callees.end() ? std::vector<std::string>() : it->second;
+}
+
+std::vector<std::string> ShortcutGraph::callers(const std::string &name) const
+{
+    auto it = m_callers.find(name);
+    return it == m_callers.end() ? std::vector<std::string>() : it->second;
+}
+
+std::vector<std::string> ShortcutGraph::dependents(const std::string &name) const
+{
+    // Everything that reaches name...
+    std::set<std::string> reached;
+    std::vector<std::string> pending = callers(name);
+    while (!pending.empty()) {
+        std::string caller = pending.back();
+        pending.pop_back();
+        if (caller != name && reached.insert(caller).second) {
+            for (const std::string &next : callers(caller)) {
+                pending.push_back(next);
+            }
+        }
+    }
+
+    // ...in post-order over the calls, so callees come first
+    std::vector<std::string> ordered;
+    std::set<std::string> visited;
+    std::function<void(const std::string &)> visit = [&](const std::string &node) {
+        if (!visited.insert(node).second) {
+            return;
+        }
+        for (const std::string &callee : callees(node)) {
+            if (reached.count(callee)) {
+                visit(callee);
+            }
+        }
+        ordered.push_back(node);
+    };
+    for (const std::string &node : reached) {
+        visit(node);
+    }
+    return ordered;
+}
+
+std::vector<std::string> ShortcutGraph::longestChain(const std::string &name) const
+{
+    std::map<std::string, std::vector<std::string>> memo;
+    std::function<const std::vector<std::string> &(const std::string &)> chain =
+        [&](const std::string &node) -> const std::vector<std::string> & {
+        auto it = memo.find(node);
+        if (it != memo.end()) {
+            return it->second;
+        }
+
+        std::vector<std::string> best;
+        if (!inCycle(node)) {
+            for (const std::string &callee : callees(node)) {
+                const std::vector<std::string> &candidate = chain(callee);
+                if (candidate.size() > best.size()) {
+                    best = candidate;
+                }
+            }
+        }
+        best.insert(best.begin(), node);
+        return memo[node] = best;
+    };
+
+    return contains(name) ? chain(name) : std::vector<std::string>();
+}
+
+bool ShortcutGraph::isTriviallyForwarding(std::string_view line)
+{
+    std::string body = StringUtil::trimmed(line);
+    stripForwardedArguments(body);
+    if (body.empty()) {
+        return false;
+    }
+
+    char quote = 0;
+    for (size_t i = 0; i < body.size(); ++i) {
+        char c = body[i];
+        if (c == '$' && i + 1 < body.size() && quote != '\'') {
+            char next = body[i + 1];
+            if (next == '@' || next == '*' || next == '#' || next == '{' || next == '('
+                || (next >= '0' && next <= '9')) {
+                return false;
+            }
+        }
+        if (quote) {
+            if (c == '\\' && quote == '"') {
+                ++i;
+            } else if (c == quote) {
+                quote = 0;
+            } else if (c == '`' && quote == '"') {
+                return false;
+            }
+        } else if (c == '\\') {
+            ++i;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == ';' || c == '&' || c == '|' || c == '(' || c == ')' || c == '`'
+                   || c == '<' || c == '>' || c == '\n') {
+            return false;
+        }
+    }
+    if (quote != 0) {
+        return false;
+    }
+
+    // The command itself must be an external program; only sudo, nohup and
+    // assignments may come before it
+    for (size_t pos = 0; pos < body.size(); ) {
+        size_t stop = wordEnd(body, pos);
+        std::string_view word = std::string_view(body).substr(pos, stop - pos);
+        if (word != "sudo" && word != "nohup" && !isAssignment(word)) {
+            return !isShellBuiltin(word);
+        }
+        pos = stop;
+        while (pos < body.size() && isBlank(body[pos])) {
+            ++pos;
+        }
+    }
+    return false;
+}
+
+std::string ShortcutGraph::flattenLine(const std::string &line, std::vector<std::string> &visiting) const
+{
+    std::string result;
+    size_t pos = 0;
+    for (const Invocation &invocation : invocations(line)) {
+        std::string callee = resolve(std::string_view(line).substr(
+            invocation.begin, invocation.wordEnd - invocation.begin));
+        if (callee.empty() || inCycle(callee)
+            || std::find(visiting.begin(), visiting.end(), callee) != visiting.end()) {
+            continue;
+        }
+
+        visiting.push_back(callee);
+        std::string body = flattenLine(m_lines.at(callee), visiting);
+        visiting.pop_back();
+        if (!isTriviallyForwarding(body)) {
+            continue;
+        }
+
+        // A callee that ignores its arguments can only be inlined where none are
+        // passed (they may include redirections, which must not be lost)
+        body = StringUtil::trimmed(body);
+        bool forwardsArguments = stripForwardedArguments(body);
+        std::string arguments = StringUtil::trimmed(
+            std::string_view(line).substr(invocation.wordEnd, invocation.end - invocation.wordEnd));
+        if (!forwardsArguments && !arguments.empty()) {
+            continue;
+        }
+        if (invocation.elevated && StringUtil::startsWith(body, "sudo ")) {
+            body.erase(0, 5);
+        }
+
+        result.append(line, pos, invocation.begin - pos);
+        result += body;
+        if (!arguments.empty()) {
+            result += " " + arguments;
+        }
+        pos = invocation.end;
+    }
+    result.append(line, pos, std::string::npos);
+    return result;
+}
+
+std::string ShortcutGraph::flatten(const std::string &name) const
+{
+    auto it = m_lines.find(name);
+    if (it == m_lines.end()) {
+        return std::string();
+    }
+    std::vector<std::string> visiting{name};
+    return flattenLine(it->second, visiting);
+}
+
+std::string ShortcutGraph::script(const std::string &name, bool flattenChains) const
+{
+    auto it = m_lines.find(name);
+    if (it == m_lines.end()) {
+        return std::string();
+    }
+    return ScriptGenerator::flattenedScript(it->second, flattenChains ? flatten(name) : it->second);
+}
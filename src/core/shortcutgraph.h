@@ -0,0 +1,72 @@
+#ifndef SHORTCUTGRAPH_H
+#define SHORTCUTGRAPH_H
+
+#include "shortcut.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Which shortcuts call which, found by looking at the command word of every
+// simple command in their command lines. Used to show call chains, to find
+// cycles, and to flatten chains: a callee whose command line is a single simple
+// command is inlined into its callers, so `deploy` -> `build` -> `make` runs as
+// one process instead of three.
+class ShortcutGraph
+{
+public:
+    // Replace the graph. Commands are full command lines as returned by
+    // ShortcutParser::commandLine; calls through directory/<name> count as calls
+    // too.
+    void build(const std::vector<Shortcut> &shortcuts, const std::string &directory = std::string());
+
+    // Add or replace one shortcut, or drop one, and re-index
+    void insert(const Shortcut &shortcut);
+    void remove(const std::string &name);
+
+    bool contains(const std::string &name) const { return m_lines.count(name) > 0; }
+    std::vector<std::string> names() const;
+
+    // Direct calls in both directions, sorted
+    std::vector<std::string> callees(const std::string &name) const;
+    std::vector<std::string> callers(const std::string &name) const;
+
+    // Every shortcut that reaches name through a chain of calls, ordered so each
+    // comes after the shortcuts it calls: the order to regenerate them in
+    std::vector<std::string> dependents(const std::string &name) const;
+
+    // Groups of shortcuts that call each other in a loop, and membership test
+    const std::vector<std::vector<std::string>> &cycles() const { return m_cycles; }
+    bool inCycle(const std::string &name) const { return m_cyclic.count(name) > 0; }
+
+    // The longest chain of calls starting at name; stops at a cycle
+    std::vector<std::string> longestChain(const std::string &name) const;
+
+    // The command line of name with every trivially forwarding callee inlined.
+    // Shortcuts in a cycle are never inlined.
+    std::string flatten(const std::string &name) const;
+
+    // Script to write for name, flattened or as the user wrote it
+    std::string script(const std::string &name, bool flattenChains) const;
+
+    // A single simple command running an external program: no control operators,
+    // redirections, subshells, substitutions or shell builtins (exec, exit, cd,
+    // export...), and no positional parameters except a trailing $@
+    static bool isTriviallyForwarding(std::string_view line);
+
+private:
+    void index();
+    std::string resolve(std::string_view word) const;
+    std::string flattenLine(const std::string &line, std::vector<std::string> &visiting) const;
+
+    std::string m_directory;
+    std::map<std::string, std::string> m_lines; // name -> command line
+    std::map<std::string, std::vector<std::string>> m_callees;
+    std::map<std::string, std::vector<std::string>> m_callers;
+    std::set<std::string> m_cyclic;
+    std::vector<std::vector<std::string>> m_cycles;
+};
+
+#endif // SHORTCUTGRAPH_H
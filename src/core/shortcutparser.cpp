@@ -0,0 +1,96 @@
+#include "shortcutparser.h"
+#include "scriptgenerator.h"
+#include "stringutil.h"
+#include "trace.h"
+
+bool ShortcutParser::isValidName(std::string_view name)
+{
+    // Check if name is empty
+    if (name.empty()) {
+        return false;
+    }
+
+    // Check for invalid characters (only allow alphanumeric, underscore, and hyphen)
+    for (char c : name) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+               || (c >= '0' && c <= '9') || c == '_' || c == '-';
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CommandOptions ShortcutParser::detectOptions(std::string_view command)
+{
+    CommandOptions options;
+    options.useSudo = StringUtil::contains(command, "sudo ");
+    options.runInBackground = StringUtil::contains(command, "nohup ")
+                           || StringUtil::endsWith(command, " &");
+    options.openEnded = StringUtil::contains(command, "$@");
+    return options;
+}
+
+std::string ShortcutParser::stripOptions(std::string_view command)
+{
+    std::string_view bare = StringUtil::trimmedView(command);
+
+    if (StringUtil::startsWith(bare, "nohup ")) {
+        bare = StringUtil::trimmedView(bare.substr(6));
+    }
+    if (StringUtil::startsWith(bare, "sudo ")) {
+        bare = StringUtil::trimmedView(bare.substr(5));
+    }
+    if (StringUtil::endsWith(bare, " &")) {
+        bare = StringUtil::trimmedView(bare.substr(0, bare.size() - 2));
+    }
+    if (StringUtil::endsWith(bare, " \"$@\"")) {
+        bare = StringUtil::trimmedView(bare.substr(0, bare.size() - 5));
+    } else if (StringUtil::endsWith(bare, " $@")) {
+        bare = StringUtil::trimmedView(bare.substr(0, bare.size() - 3));
+    }
+
+    return std::string(bare);
+}
+
+std::string ShortcutParser::commandLine(std::string_view content)
+{
+    // A flattened script runs an inlined body; the user's command is the source
+    const std::string_view marker = ScriptGenerator::FLATTENED_MARKER;
+    size_t source = content.find(marker);
+    if (source != std::string_view::npos && (source == 0 || content[source - 1] == '\n')) {
+        source += marker.size();
+        size_t lineEnd = content.find('\n', source);
+        return StringUtil::trimmed(content.substr(source, lineEnd == std::string_view::npos
+                                                              ? std::string_view::npos
+                                                              : lineEnd - source));
+    }
+
+    // Walk the lines backwards looking for the last non-empty, non-comment line
+    size_t end = content.size();
+    while (end > 0) {
+        size_t begin = content.rfind('\n', end - 1);
+        begin = (begin == std::string_view::npos) ? 0 : begin + 1;
+
+        std::string_view line = StringUtil::trimmedView(content.substr(begin, end - begin));
+        if (!line.empty() && line.front() != '#') {
+            return std::string(line);
+        }
+
+        end = begin > 0 ? begin - 1 : 0;
+    }
+    return std::string();
+}
+
+Shortcut ShortcutParser::parse(std::string_view content)
+{
+    TRACE_SCOPE("ShortcutParser::parse");
+    // The options come from the line as written; the command loses the
+    // decorations they add, so the editor and the generator do not add them twice
+    const std::string line = commandLine(content);
+    Shortcut shortcut;
+    shortcut.command = stripOptions(line);
+    shortcut.options = detectOptions(line);
+    return shortcut;
+}
@@ -0,0 +1,33 @@
+#ifndef SHORTCUTPARSER_H
+#define SHORTCUTPARSER_H
+
+#include "shortcut.h"
+
+#include <string>
+#include <string_view>
+
+class ShortcutParser
+{
+public:
+    // Only letters, digits, underscores and hyphens are allowed
+    static bool isValidName(std::string_view name);
+
+    // Recover the command and its options from a script's contents: the bare
+    // command, as the user typed it, and the options its command line implies.
+    // Generating a script from the result gives back the same command line.
+    static Shortcut parse(std::string_view content);
+
+    // The command line a script runs, decorations included: the last non-empty
+    // line that is not a comment, or the source recorded by
+    // ScriptGenerator::flattenedScript
+    static std::string commandLine(std::string_view content);
+
+    // Options implied by a command line as written to disk
+    static CommandOptions detectOptions(std::string_view command);
+
+    // The command without the decorations ScriptGenerator adds for the options
+    // (leading nohup/sudo, trailing $@ and &), ready to be generated again
+    static std::string stripOptions(std::string_view command);
+};
+
+#endif // SHORTCUTPARSER_H
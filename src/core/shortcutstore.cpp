@@ -0,0 +1,41 @@
+#include "shortcutstore.h"
+#include "shortcutparser.h"
+
+bool ShortcutStore::read(const std::string &name, std::string &content, std::string *error) const
+{
+    Contents contents;
+    if (!map(name, contents, error)) {
+        return false;
+    }
+    content.assign(contents.view());
+    return true;
+}
+
+bool ShortcutStore::write(const std::string &name, const std::string &content, std::string *error)
+{
+    return applyBatch({{Operation::Write, name, content}}, error);
+}
+
+bool ShortcutStore::remove(const std::string &name, std::string *error)
+{
+    if (!exists(name)) {
+        if (error) {
+            *error = "No such shortcut: " + path(name);
+        }
+        return false;
+    }
+    return applyBatch({{Operation::Remove, name, std::string()}}, error);
+}
+
+bool ShortcutStore::validate(const std::vector<Operation> &operations, std::string *error)
+{
+    for (const Operation &operation : operations) {
+        if (!ShortcutParser::isValidName(operation.name)) {
+            if (error) {
+                *error = "Invalid shortcut name: " + operation.name;
+            }
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,103 @@
+#ifndef SHORTCUTSTORE_H
+#define SHORTCUTSTORE_H
+
+#include "fileclassifier.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Where shortcut scripts live. The front end, the prefetcher and the health
+// check only talk to this interface; DirectoryStore keeps them in a directory
+// (/usr/local/bin by default), MemoryStore in memory for tests and benchmarks,
+// and OverlayStore layers a writable user directory over a read-only system one.
+//
+// Implementations are safe to read from several threads while one thread
+// writes.
+class ShortcutStore
+{
+public:
+    virtual ~ShortcutStore() = default;
+
+    // Read-only contents of one shortcut. The view stays valid for as long as
+    // this object lives, even if the shortcut is replaced or removed meanwhile:
+    // stores only ever replace whole files, never write into one. A directory
+    // store may map large files instead of copying them; another program
+    // truncating such a file in place while it is viewed makes reading it raise
+    // SIGBUS, which nothing here guards against.
+    class Contents
+    {
+    public:
+        Contents() = default;
+        Contents(std::shared_ptr<const void> owner, std::string_view view)
+            : m_owner(std::move(owner))
+            , m_view(view)
+        {
+        }
+
+        std::string_view view() const { return m_view; }
+
+    private:
+        std::shared_ptr<const void> m_owner;
+        std::string_view m_view;
+    };
+
+    // A name with its file classified from its first bytes, so foreign binaries
+    // can be told apart without reading them
+    struct Entry {
+        std::string name;
+        FileClassifier::Info info;
+    };
+
+    // One change in a batch
+    struct Operation {
+        enum Type { Write, Remove };
+        Type type = Write;
+        std::string name;
+        std::string content;
+    };
+
+    // Human-readable location for messages, and the directory new shortcuts are
+    // written to (empty when the store is not backed by one)
+    virtual std::string location() const = 0;
+    virtual std::string directory() const = 0;
+    virtual std::string path(const std::string &name) const = 0;
+
+    // Whether the store can be listed and written at all
+    virtual bool available() const = 0;
+    virtual bool exists(const std::string &name) const = 0;
+
+    // Names of the executable, non-hidden regular files, sorted
+    virtual std::vector<std::string> list() const = 0;
+
+    // list() with every entry classified, sorted by name
+    virtual std::vector<Entry> entries() const = 0;
+    virtual bool inspect(const std::string &name, FileClassifier::Info &info,
+                         std::string *error = nullptr) const = 0;
+
+    // Read without an extra copy where the backend can; see Contents
+    virtual bool map(const std::string &name, Contents &contents, std::string *error = nullptr) const = 0;
+
+    // Apply several changes as one transaction: every new script is staged first
+    // and only then put in place, so a failure while staging changes nothing.
+    // Names are validated up front.
+    virtual bool applyBatch(const std::vector<Operation> &operations, std::string *error = nullptr) = 0;
+
+    // Changes whenever the contents may have changed, including changes made by
+    // other processes; poll it to decide whether a rescan is needed
+    virtual uint64_t version() const = 0;
+
+    // Conveniences over map() and applyBatch(). remove() fails if name does not
+    // exist.
+    bool read(const std::string &name, std::string &content, std::string *error = nullptr) const;
+    bool write(const std::string &name, const std::string &content, std::string *error = nullptr);
+    bool remove(const std::string &name, std::string *error = nullptr);
+
+protected:
+    // Shared by the backends: every name in operations is a valid shortcut name
+    static bool validate(const std::vector<Operation> &operations, std::string *error);
+};
+
+#endif // SHORTCUTSTORE_H
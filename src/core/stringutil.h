@@ -0,0 +1,51 @@
+#ifndef STRINGUTIL_H
+#define STRINGUTIL_H
+
+#include <string>
+#include <string_view>
+
+// Small helpers mirroring the QString conveniences the GUI code relies on
+namespace StringUtil {
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline std::string_view trimmedView(std::string_view s)
+{
+    size_t begin = 0;
+    size_t end = s.size();
+    while (begin < end && isSpace(s[begin])) {
+        ++begin;
+    }
+    while (end > begin && isSpace(s[end - 1])) {
+        --end;
+    }
+    return s.substr(begin, end - begin);
+}
+
+inline std::string trimmed(std::string_view s)
+{
+    return std::string(trimmedView(s));
+}
+
+inline bool startsWith(std::string_view s, std::string_view prefix)
+{
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+inline bool endsWith(std::string_view s, std::string_view suffix)
+{
+    return s.size() >= suffix.size()
+        && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+inline bool contains(std::string_view s, std::string_view needle)
+{
+    return s.find(needle) != std::string_view::npos;
+}
+
+} // namespace StringUtil
+
+#endif // STRINGUTIL_H
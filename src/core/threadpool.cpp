@@ -0,0 +1,123 @@
+#include "threadpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+// Which pool and deque the current thread works for, if any
+thread_local const ThreadPool *t_pool = nullptr;
+thread_local unsigned t_index = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        m_threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeUp.notify_all();
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    unsigned index = t_pool == this ? t_index : m_next++ % size();
+
+    // Count the task before any worker can see it: one already awake may take and
+    // finish it before this thread gets to the counters
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_queued;
+        ++m_unfinished;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_wakeUp.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_unfinished == 0; });
+}
+
+bool ThreadPool::take(unsigned self, std::function<void()> &task)
+{
+    // Own deque, newest first: its data is the most likely to still be cached
+    {
+        Queue &own = *m_queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another worker
+    for (unsigned offset = 1; offset < size(); ++offset) {
+        Queue &victim = *m_queues[(self + offset) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(unsigned self)
+{
+    t_pool = this;
+    t_index = self;
+    Trace::setThreadName(("pool " + std::to_string(self)).c_str());
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this] { return m_stopping || m_queued > 0; });
+            if (m_stopping) {
+                return;
+            }
+        }
+
+        std::function<void()> task;
+        if (!take(self, task)) {
+            // Another worker got there first
+            std::this_thread::yield();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_queued;
+        }
+
+        task();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_unfinished == 0) {
+            m_idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker takes
+// from the back of its own deque and, when that is empty, steals from the front
+// of the others, so uneven tasks (one slow file among many fast ones) do not
+// leave threads idle. Tasks submitted from a worker go to that worker's deque.
+class ThreadPool
+{
+public:
+    // threads == 0 uses one per hardware thread. Destroying the pool waits for
+    // running tasks and drops those not yet started.
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(m_threads.size()); }
+
+    void submit(std::function<void()> task);
+
+    // Block until every task submitted so far has finished
+    void wait();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(unsigned self, std::function<void()> &task);
+    void run(unsigned self);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<unsigned> m_next{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_idle;
+    size_t m_queued = 0;     // submitted, not yet taken
+    size_t m_unfinished = 0; // submitted, not yet finished
+    bool m_stopping = false;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,202 @@
+#include "trace.h"
+#include "fileutil.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<bool> Trace::s_enabled{false};
+
+namespace {
+
+struct Event {
+    const char *name;
+    std::string arg;
+    int64_t begin;
+    int64_t end;
+};
+
+// Owned by one thread; the mutex is only ever contended by the final write()
+struct ThreadBuffer {
+    std::mutex mutex;
+    long tid = 0;
+    std::string threadName;
+    std::vector<Event> events;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::string outputPath;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    bool written = false;
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer &threadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->tid = ::syscall(SYS_gettid);
+        buffer->events.reserve(1024);
+
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void appendJsonString(std::string &out, const std::string &value)
+{
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+void appendMicros(std::string &out, int64_t ns)
+{
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.3f", static_cast<double>(ns) / 1000.0);
+    out += number;
+}
+
+void writeAtExit()
+{
+    std::string error;
+    if (!Trace::write(&error)) {
+        std::fprintf(stderr, "shorts: cannot write trace: %s\n", error.c_str());
+    }
+}
+
+} // namespace
+
+void Trace::start(const std::string &outputPath)
+{
+    Registry &reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.outputPath = outputPath;
+        reg.epoch = std::chrono::steady_clock::now();
+        reg.written = false;
+    }
+
+    // Registered after the registry exists, so it runs before the registry is destroyed
+    static bool atExitRegistered = false;
+    if (!atExitRegistered) {
+        std::atexit(writeAtExit);
+        atExitRegistered = true;
+    }
+
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const char *name)
+{
+    if (!enabled()) {
+        return;
+    }
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.threadName = name;
+}
+
+int64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void Trace::record(const char *name, std::string_view arg, int64_t begin, int64_t end)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(Event{name, std::string(arg), begin, end});
+}
+
+std::string Trace::outputPath()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.outputPath;
+}
+
+bool Trace::write(std::string *error)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (reg.outputPath.empty() || reg.written) {
+        return true;
+    }
+
+    const long pid = static_cast<long>(::getpid());
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+    };
+
+    for (const std::shared_ptr<ThreadBuffer> &buffer : reg.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        const std::string tid = std::to_string(buffer->tid);
+
+        if (!buffer->threadName.empty()) {
+            separator();
+            json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid)
+                  + ",\"tid\":" + tid + ",\"args\":{\"name\":";
+            appendJsonString(json, buffer->threadName);
+            json += "}}";
+        }
+
+        for (const Event &event : buffer->events) {
+            separator();
+            json += "{\"name\":";
+            appendJsonString(json, event.name);
+            json += ",\"cat\":\"shorts\",\"ph\":\"X\",\"ts\":";
+            appendMicros(json, event.begin);
+            json += ",\"dur\":";
+            appendMicros(json, event.end - event.begin);
+            json += ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + tid;
+            if (!event.arg.empty()) {
+                json += ",\"args\":{\"name\":";
+                appendJsonString(json, event.arg);
+                json += "}";
+            }
+            json += "}";
+        }
+    }
+    json += "]}\n";
+
+    reg.written = true;
+    return FileUtil::writeAtomic(reg.outputPath, json, 0644, error);
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Low-overhead span tracing written out as Chrome trace_event JSON (load it in
+// chrome://tracing or Perfetto).
+//
+// Tracing is off unless start() is called, which main() does for --trace <file>
+// or SHORTS_TRACE=<file>. While off, a span costs one relaxed load on entry and a
+// null check on exit. Spans are kept in per-thread buffers and written once,
+// when the process exits.
+class Trace
+{
+public:
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Start collecting spans to be written to outputPath on exit
+    static void start(const std::string &outputPath);
+
+    // Where the trace will be written; empty unless started
+    static std::string outputPath();
+
+    // Name the calling thread in the trace viewer
+    static void setThreadName(const char *name);
+
+    // Write everything collected so far; called automatically at exit
+    static bool write(std::string *error = nullptr);
+
+    static int64_t now();
+    static void record(const char *name, std::string_view arg, int64_t begin, int64_t end);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Records the lifetime of the enclosing scope as one span. name must be a string
+// literal, and arg (e.g. the shortcut being parsed) must outlive the span: it is
+// only referred to, and copied when the span ends with tracing on. A disabled
+// span is a null check on the way in and out, with nothing to destroy.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : m_name(Trace::enabled() ? name : nullptr)
+    {
+        if (m_name) {
+            m_begin = Trace::now();
+        }
+    }
+
+    TraceSpan(const char *name, const std::string &arg)
+        : TraceSpan(name, std::string_view(arg))
+    {
+    }
+
+    TraceSpan(const char *name, const char *arg)
+        : TraceSpan(name, std::string_view(arg))
+    {
+    }
+
+    // A temporary would be gone before the span ends
+    TraceSpan(const char *name, std::string &&arg) = delete;
+
+    ~TraceSpan()
+    {
+        if (m_name) {
+            Trace::record(m_name, m_arg, m_begin, Trace::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    TraceSpan(const char *name, std::string_view arg)
+        : m_name(Trace::enabled() ? name : nullptr)
+        , m_arg(arg)
+    {
+        if (m_name) {
+            m_begin = Trace::now();
+        }
+    }
+
+    const char *m_name;
+    int64_t m_begin = 0;
+    std::string_view m_arg;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(...) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_H
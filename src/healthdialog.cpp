@@ -0,0 +1,57 @@
+#include "healthdialog.h"
+
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+HealthDialog::HealthDialog(const HealthCheck::Report &report, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Shortcut Health"));
+    resize(800, 420);
+
+    const double elapsedMs = static_cast<double>(report.elapsedNs) / 1e6;
+    QLabel *summary = new QLabel(this);
+    if (report.findings.empty()) {
+        summary->setText(tr("All %n shortcut(s) look healthy (checked in %1 ms).", nullptr,
+                            static_cast<int>(report.checked)).arg(elapsedMs, 0, 'f', 0));
+    } else {
+        summary->setText(tr("%1 problem(s) in %2 checked shortcuts (checked in %3 ms).")
+                         .arg(report.findings.size()).arg(report.checked).arg(elapsedMs, 0, 'f', 0));
+    }
+
+    m_table = new QTableWidget(static_cast<int>(report.findings.size()), 4, this);
+    m_table->setHorizontalHeaderLabels({tr("Shortcut"), tr("Problem"), tr("Target"), tr("Detail")});
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+
+    int row = 0;
+    for (const HealthCheck::Finding &finding : report.findings) {
+        m_table->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(finding.name)));
+        m_table->setItem(row, 1, new QTableWidgetItem(QString::fromLatin1(HealthCheck::describe(finding.problem))));
+        m_table->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(finding.target)));
+        m_table->setItem(row, 3, new QTableWidgetItem(QString::fromStdString(finding.detail)));
+        ++row;
+    }
+
+    // Filling a sorted table re-sorts on every insert, so sort once at the end
+    m_table->setSortingEnabled(true);
+    m_table->sortByColumn(1, Qt::AscendingOrder);
+    m_table->resizeColumnsToContents();
+
+    connect(m_table, &QTableWidget::cellDoubleClicked, this, [this](int row) {
+        emit shortcutActivated(m_table->item(row, 0)->text());
+    });
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(summary);
+    layout->addWidget(m_table);
+    layout->addWidget(buttons);
+}
@@ -0,0 +1,27 @@
+#ifndef HEALTHDIALOG_H
+#define HEALTHDIALOG_H
+
+#include <QDialog>
+#include <QString>
+
+#include "core/healthcheck.h"
+
+class QTableWidget;
+
+// The problems found by a health check, one row per problem, sortable by any
+// column. Double-clicking a row selects that shortcut in the main window.
+class HealthDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit HealthDialog(const HealthCheck::Report &report, QWidget *parent = nullptr);
+
+signals:
+    void shortcutActivated(const QString &name);
+
+private:
+    QTableWidget *m_table;
+};
+
+#endif // HEALTHDIALOG_H
@@ -0,0 +1,84 @@
+#include "historydialog.h"
+
+#include <QDateTime>
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QListWidget>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include "core/historypack.h"
+
+HistoryDialog::HistoryDialog(const HistoryPack &history, const QString &name, QWidget *parent)
+    : QDialog(parent)
+    , m_history(history)
+    , m_name(name)
+{
+    setWindowTitle(tr("History of '%1'").arg(name));
+    resize(700, 400);
+
+    m_versionList = new QListWidget(this);
+    m_versionList->setMaximumWidth(220);
+
+    m_contentView = new QPlainTextEdit(this);
+    m_contentView->setReadOnly(true);
+    m_contentView->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+    QHBoxLayout *contentLayout = new QHBoxLayout;
+    contentLayout->addWidget(m_versionList);
+    contentLayout->addWidget(m_contentView);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    m_restoreButton = buttons->addButton(tr("Restore"), QDialogButtonBox::AcceptRole);
+    m_restoreButton->setEnabled(false);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(contentLayout);
+    layout->addWidget(buttons);
+
+    // Newest version first
+    const std::vector<HistoryVersion> versions = m_history.versions(name.toStdString());
+    for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+        QString when = QDateTime::fromSecsSinceEpoch(it->timestamp).toString("yyyy-MM-dd hh:mm:ss");
+        QListWidgetItem *item = new QListWidgetItem(tr("v%1  %2").arg(it->version).arg(when));
+        item->setData(Qt::UserRole, it->version);
+        m_versionList->addItem(item);
+    }
+
+    connect(m_versionList, &QListWidget::currentRowChanged, this, &HistoryDialog::onVersionSelected);
+
+    if (m_versionList->count() > 0) {
+        m_versionList->setCurrentRow(0);
+    } else {
+        m_contentView->setPlainText(tr("No saved versions of this shortcut yet."));
+    }
+}
+
+void HistoryDialog::onVersionSelected(int row)
+{
+    QListWidgetItem *item = m_versionList->item(row);
+    if (!item) {
+        m_restoreButton->setEnabled(false);
+        return;
+    }
+
+    uint32_t version = item->data(Qt::UserRole).toUInt();
+    std::string content;
+    std::string error;
+    if (!m_history.load(m_name.toStdString(), version, content, &error)) {
+        m_contentView->setPlainText(tr("Cannot load version %1: %2")
+                                    .arg(version).arg(QString::fromStdString(error)));
+        m_restoreButton->setEnabled(false);
+        return;
+    }
+
+    m_selectedVersion = static_cast<int>(version);
+    m_selectedContent = QString::fromStdString(content);
+    m_contentView->setPlainText(m_selectedContent);
+
+    // Restoring the newest version would be a no-op
+    m_restoreButton->setEnabled(row != 0);
+}
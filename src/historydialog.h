@@ -0,0 +1,39 @@
+#ifndef HISTORYDIALOG_H
+#define HISTORYDIALOG_H
+
+#include <QDialog>
+#include <QString>
+
+class HistoryPack;
+class QListWidget;
+class QPlainTextEdit;
+class QPushButton;
+
+// Lists the saved versions of one shortcut, newest first, and shows the script
+// of the selected version. Accepting the dialog means "restore this version".
+class HistoryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    HistoryDialog(const HistoryPack &history, const QString &name, QWidget *parent = nullptr);
+
+    // Script of the version the user chose to restore
+    QString selectedContent() const { return m_selectedContent; }
+    int selectedVersion() const { return m_selectedVersion; }
+
+private slots:
+    void onVersionSelected(int row);
+
+private:
+    const HistoryPack &m_history;
+    QString m_name;
+    QString m_selectedContent;
+    int m_selectedVersion = -1;
+
+    QListWidget *m_versionList;
+    QPlainTextEdit *m_contentView;
+    QPushButton *m_restoreButton;
+};
+
+#endif // HISTORYDIALOG_H
@@ -7,12 +7,60 @@
 #include <unistd.h>
 #include <QStandardPaths>
 #include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "singleinstance.h"
+#include "core/directorystore.h"
+#include "core/functionlibrary.h"
+#include "core/healthcheck.h"
+#include "core/historypack.h"
+#include "core/overlaystore.h"
+#include "core/trace.h"
+
+// QApplication that records every paint event as a span while tracing is on
+class TracingApplication : public QApplication {
+public:
+    using QApplication::QApplication;
+    
+    bool notify(QObject *receiver, QEvent *event) override {
+        if (Trace::enabled() && event->type() == QEvent::Paint) {
+            TraceSpan span("paint", receiver->metaObject()->className());
+            return QApplication::notify(receiver, event);
+        }
+        return QApplication::notify(receiver, event);
+    }
+};
 
 bool isRunningAsRoot() {
     return geteuid() == 0;
 }
 
+// Arguments for the privileged re-exec. A traced launch hands its child a trace
+// file of its own, FILE.elevated, as an explicit --trace: with the same --trace
+// FILE the child would overwrite this process's trace when it exits, and pkexec
+// drops SHORTS_TRACE from the environment.
+QStringList elevatedArguments() {
+    QStringList args = QCoreApplication::arguments();
+    args.removeFirst(); // Remove the program name
+    for (int i = args.indexOf("--trace"); i >= 0; i = args.indexOf("--trace")) {
+        args.removeAt(i);
+        if (i < args.size()) {
+            args.removeAt(i);
+        }
+    }
+    if (Trace::enabled()) {
+        args << "--trace" << QString::fromStdString(Trace::outputPath()) + ".elevated";
+    }
+    return args;
+}
+
 bool restartWithPrivileges() {
+    TRACE_SCOPE("restartWithPrivileges");
     QString appPath = QCoreApplication::applicationFilePath();
     QProcess process;
     
@@ -20,26 +68,135 @@ bool restartWithPrivileges() {
     process.start("which", {"pkexec"});
     process.waitForFinished();
     if (process.exitCode() == 0) {
-        QStringList args = QCoreApplication::arguments();
-        args.removeFirst(); // Remove the program name
-        return QProcess::startDetached("pkexec", QStringList() << appPath << args);
+        return QProcess::startDetached("pkexec", QStringList() << appPath << elevatedArguments());
     }
     
     // Fall back to sudo if pkexec is not available
     process.start("which", {"sudo"});
     process.waitForFinished();
     if (process.exitCode() == 0) {
-        QStringList args = QCoreApplication::arguments();
-        args.prepend(appPath);
-        return QProcess::startDetached("sudo", args);
+        return QProcess::startDetached("sudo", QStringList() << appPath << elevatedArguments());
     }
     
     return false;
 }
 
+// Position of option among the arguments, or 0 if it was not given
+int findOption(int argc, char *argv[], const char *option) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], option) == 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// Rewrite the history pack offline, optionally keeping only the newest versions
+int compactHistory(size_t keepVersions) {
+    HistoryPack history;
+    std::string error;
+    if (!history.open(&error)) {
+        std::fprintf(stderr, "Cannot open %s: %s\n", history.path().c_str(), error.c_str());
+        return 1;
+    }
+    
+    uint64_t before = history.size();
+    if (!history.compact(keepVersions, &error)) {
+        std::fprintf(stderr, "Compaction failed: %s\n", error.c_str());
+        return 1;
+    }
+    
+    std::printf("Compacted %s: %llu -> %llu bytes\n", history.path().c_str(),
+                static_cast<unsigned long long>(before),
+                static_cast<unsigned long long>(history.size()));
+    return 0;
+}
+
+// The shortcuts to manage: /usr/local/bin, or with --user-dir <dir> that
+// directory layered over a read-only /usr/local/bin
+std::unique_ptr<ShortcutStore> createStore(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (qstrcmp(argv[i], "--user-dir") == 0) {
+            return std::make_unique<OverlayStore>(QFileInfo(argv[i + 1]).absoluteFilePath().toStdString());
+        }
+    }
+    return std::make_unique<DirectoryStore>();
+}
+
+// Check every script shortcut and library function; exits non-zero if any is broken
+int checkAll(std::shared_ptr<const ShortcutStore> store) {
+    std::vector<std::string> names;
+    for (const ShortcutStore::Entry &entry : store->entries()) {
+        if (entry.info.kind == FileClassifier::Kind::Shortcut) {
+            names.push_back(entry.name);
+        }
+    }
+    
+    HealthCheck health;
+    HealthCheck::Report report = health.run(store, names);
+    
+    FunctionLibrary library;
+    std::vector<Shortcut> functions;
+    if (library.load()) {
+        for (const std::string &name : library.list()) {
+            Shortcut shortcut;
+            if (library.get(name, shortcut)) {
+                shortcut.name = name;
+                functions.push_back(shortcut);
+            }
+        }
+    }
+    HealthCheck::Report libraryReport = health.run(functions);
+    report.checked += libraryReport.checked;
+    report.elapsedNs += libraryReport.elapsedNs;
+    report.findings.insert(report.findings.end(), libraryReport.findings.begin(), libraryReport.findings.end());
+    
+    std::sort(report.findings.begin(), report.findings.end(),
+              [](const HealthCheck::Finding &a, const HealthCheck::Finding &b) {
+                  return a.problem != b.problem ? a.problem < b.problem : a.name < b.name;
+              });
+    for (const HealthCheck::Finding &finding : report.findings) {
+        std::printf("%-24s %-18s %s (%s)\n", finding.name.c_str(), HealthCheck::describe(finding.problem),
+                    finding.target.c_str(), finding.detail.c_str());
+    }
+    std::printf("%zu problem(s) in %zu shortcuts, checked in %.0f ms\n", report.findings.size(),
+                report.checked, static_cast<double>(report.elapsedNs) / 1e6);
+    return report.findings.empty() ? 0 : 1;
+}
+
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    // Tracing: --trace <file> or SHORTS_TRACE=<file>; written out on exit
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (qstrcmp(argv[i], "--trace") == 0) {
+            Trace::start(QFileInfo(argv[i + 1]).absoluteFilePath().toStdString());
+        }
+    }
+    if (!Trace::enabled() && qEnvironmentVariableIsSet("SHORTS_TRACE")) {
+        Trace::start(QFileInfo(qgetenv("SHORTS_TRACE")).absoluteFilePath().toStdString());
+    }
+    Trace::setThreadName("GUI");
+    
+    // Offline maintenance that needs neither a display nor the GUI, and is never
+    // handed to a resident instance
+    if (int option = findOption(argc, argv, "--compact-history")) {
+        return compactHistory(option + 1 < argc ? std::strtoul(argv[option + 1], nullptr, 10) : 0);
+    }
+    if (findOption(argc, argv, "--check-all")) {
+        return checkAll(createStore(argc, argv));
+    }
+    
+    // A resident instance managing the same store only needs to be told to show
+    // itself; nothing else of the normal start-up (Qt, privilege re-exec,
+    // styling, scanning) is paid again
+    const bool resident = findOption(argc, argv, "--resident") > 0;
+    std::unique_ptr<ShortcutStore> store = createStore(argc, argv);
+    const QString storeLocation = QString::fromStdString(store->location());
+    if (SingleInstance::activateRunning(storeLocation, 200)) {
+        return 0;
+    }
+    
+    TracingApplication app(argc, argv);
     
     // Set application properties for better window manager integration
     app.setApplicationName("shorts");  // Single word for WM_CLASS
@@ -47,8 +204,10 @@ int main(int argc, char *argv[])
     app.setOrganizationName("Windsurf");
     app.setApplicationVersion("1.0");
     
-    // Check if running as root
-    if (!isRunningAsRoot()) {
+    // Check if running as root; an overlay only ever writes to the user's own
+    // directory and needs no privileges
+    const bool needsRoot = dynamic_cast<OverlayStore *>(store.get()) == nullptr;
+    if (needsRoot && !isRunningAsRoot()) {
         // If not root, try to restart with sudo or pkexec
         if (restartWithPrivileges()) {
             return 0; // Successfully restarted with privileges
@@ -73,12 +232,28 @@ int main(int argc, char *argv[])
     }
     app.setWindowIcon(appIcon);
     
-    MainWindow window;
+    MainWindow window(std::move(store));
     
     // Set window properties for better panel integration
     window.setWindowTitle("shorts");
     window.setWindowIcon(appIcon);
     window.setWindowFlags(window.windowFlags() & ~Qt::WindowContextHelpButtonHint);
+    
+    SingleInstance instance;
+    if (resident) {
+        QString error;
+        if (instance.listen(storeLocation, &error)) {
+            QObject::connect(&instance, &SingleInstance::activationRequested, &window, &MainWindow::activate);
+            // Without a tray the process keeps serving later launches while the
+            // window is open, and exits normally when it is closed
+            if (window.setResident(true)) {
+                app.setQuitOnLastWindowClosed(false);
+            }
+        } else {
+            qWarning() << "Resident mode unavailable:" << error;
+        }
+    }
+    
     window.show();
     
     return app.exec();
@@ -3,7 +3,6 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QFile>
-#include <QUuid>
 #include <QTextStream>
 #include <QProcess>
 #include <QDir>
@@ -21,11 +20,28 @@
 #include <QPainter>
 #include <QTemporaryFile>
 #include <QCoreApplication>
+#include <QApplication>
+#include <QCloseEvent>
+#include <QSystemTrayIcon>
+#include <QInputDialog>
+#include <QMenu>
+#include <QSet>
+#include <QSignalBlocker>
+#include <QLocale>
+#include <algorithm>
+#include <set>
 
-MainWindow::MainWindow(QWidget *parent)
+#include "healthdialog.h"
+#include "historydialog.h"
+#include "core/scriptgenerator.h"
+#include "core/shortcutparser.h"
+#include "core/trace.h"
+
+MainWindow::MainWindow(std::unique_ptr<ShortcutStore> shortcutStore, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , currentShortcut()
+    , store(std::move(shortcutStore))
 {
     // Set window properties first
     setWindowTitle(tr("Shortcut Manager"));
@@ -48,8 +64,21 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->saveButton, &QPushButton::clicked, this, &MainWindow::onSaveClicked);
     connect(ui->deleteButton, &QPushButton::clicked, this, &MainWindow::onDeleteClicked);
     connect(ui->clearButton, &QPushButton::clicked, this, &MainWindow::onClearClicked);
-    connect(ui->refreshButton, &QPushButton::clicked, this, &MainWindow::refreshShortcuts);
-    connect(ui->shortcutList, &QListWidget::itemClicked, this, &MainWindow::onShortcutSelected);
+    connect(ui->historyButton, &QPushButton::clicked, this, &MainWindow::onHistoryClicked);
+    connect(ui->checkAllButton, &QPushButton::clicked, this, &MainWindow::onCheckAllClicked);
+    connect(ui->refreshButton, &QPushButton::clicked, this, [this]() {
+        // An explicit refresh may follow changes made outside Shorts
+        prefetcher.clear();
+        graphLoaded = false;
+        refreshShortcuts();
+    });
+    
+    // Follow the current item so arrow-key browsing loads shortcuts too, and warm
+    // the cache for whatever scrolls into view
+    connect(ui->shortcutList, &QListWidget::currentItemChanged, this,
+            [this](QListWidgetItem *current) { onShortcutSelected(current); });
+    connect(ui->shortcutList->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &MainWindow::prefetchNeighbours);
     
     // Connect checkboxes
     connect(ui->sudoCheckBox, &QCheckBox::toggled, this, &MainWindow::onSudoToggled);
@@ -71,6 +100,34 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->backgroundCheckBox, &QCheckBox::toggled, this, &MainWindow::updateCommandPreview);
     connect(ui->openEndedCheckBox, &QCheckBox::toggled, this, &MainWindow::updateCommandPreview);
     
+    // Open the version history; shortcuts still save without it
+    std::string historyError;
+    if (!history.open(&historyError)) {
+        qWarning() << "Shortcut history disabled:" << QString::fromStdString(historyError);
+    }
+    
+    setupBulkMenu();
+    
+    // Restore the output mode chosen last time
+    QSettings settings("0hex01", "Shorts");
+    if (settings.value("outputMode").toString() == "functions") {
+        outputMode = OutputMode::Functions;
+        ui->outputModeCombo->setCurrentIndex(1);
+    }
+    connect(ui->outputModeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onOutputModeChanged);
+    
+    ui->managedOnlyCheckBox->setChecked(settings.value("managedOnly", false).toBool());
+    connect(ui->managedOnlyCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        QSettings("0hex01", "Shorts").setValue("managedOnly", checked);
+        applyListFilter();
+    });
+    
+    flattenChains = settings.value("flattenChains", false).toBool();
+    ui->flattenCheckBox->setChecked(flattenChains);
+    ui->flattenCheckBox->setEnabled(outputMode == OutputMode::Scripts);
+    connect(ui->flattenCheckBox, &QCheckBox::toggled, this, &MainWindow::onFlattenToggled);
+    
     // Set size policy to prevent unwanted resizing
     setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
     
@@ -185,6 +242,18 @@ chmod +x ~/.local/share/applications/shorts.desktop
 
 MainWindow::~MainWindow()
 {
+    healthCancel = true;
+    if (healthThread.joinable()) {
+        healthThread.join();
+    }
+    
+    Prefetcher::Stats stats = prefetcher.stats();
+    qDebug() << "Prefetch cache:" << stats.hits << "hits," << stats.misses << "misses,"
+             << "hit rate" << QString::number(stats.hitRate() * 100.0, 'f', 1) + "%,"
+             << "avg miss" << QString::number(stats.averageMissMs(), 'f', 2) << "ms,"
+             << "max miss" << QString::number(stats.maxMissNs / 1e6, 'f', 2) << "ms,"
+             << stats.prefetched << "prefetched";
+    
     delete ui;
 }
 
@@ -365,30 +434,9 @@ void MainWindow::onBrowseClicked()
     }
 }
 
-bool MainWindow::isValidShortcutName(const QString &name)
-{
-    // Check if name is empty
-    if (name.isEmpty()) {
-        return false;
-    }
-    
-    // Check for invalid characters (only allow alphanumeric, underscore, and hyphen)
-    static QRegularExpression regex("^[a-zA-Z0-9_-]+$");
-    if (!regex.match(name).hasMatch()) {
-        return false;
-    }
-    
-    // Check if name is a reserved name
-    static const QStringList reservedNames = {"..", ".", "/", ""};
-    if (reservedNames.contains(name)) {
-        return false;
-    }
-    
-    return true;
-}
-
 void MainWindow::onSaveClicked()
 {
+    TRACE_SCOPE("MainWindow::onSaveClicked");
     QString name = ui->nameEdit->text().trimmed();
     QString command = ui->commandEdit->text().trimmed();
     
@@ -398,23 +446,39 @@ void MainWindow::onSaveClicked()
     }
     
     // Validate the shortcut name
-    if (!isValidShortcutName(name)) {
+    if (!ShortcutParser::isValidName(name.toStdString())) {
         QMessageBox::warning(this, tr("Invalid Name"), 
             tr("Shortcut name can only contain letters, numbers, underscores, and hyphens.\n"
                "It cannot be empty or contain spaces or special characters."));
         return;
     }
     
-    // Create the shortcut file path
-    QString shortcutPath = QString("%1/%2").arg(SHORTCUT_DIR, name);
+    // Foreign binaries in the directory are read-only
+    FileClassifier::Info existing;
+    const bool fileExists = outputMode == OutputMode::Scripts && store->inspect(name.toStdString(), existing);
+    if (fileExists && existing.kind != FileClassifier::Kind::Shortcut
+        && existing.kind != FileClassifier::Kind::Script) {
+        QMessageBox::warning(this, tr("Read-only"),
+            tr("'%1' is an existing %2 that was not created by Shorts. Choose another name.")
+            .arg(name, QString::fromLatin1(FileClassifier::describe(existing.kind))));
+        return;
+    }
     
-    // Check if the shortcut already exists
-    QFileInfo existingFile(shortcutPath);
-    if (existingFile.exists() && existingFile.fileName() != currentShortcut) {
+    // Check if the shortcut already exists. Hand-written scripts are never
+    // replaced silently, not even the one being edited: saving swaps them for a
+    // generated shortcut.
+    QString overwrite;
+    if (fileExists && existing.kind == FileClassifier::Kind::Script) {
+        overwrite = tr("'%1' is a script that was not created by Shorts. Saving replaces it with a "
+                       "generated shortcut. Do you want to overwrite it?").arg(name);
+    } else if (shortcutExists(name) && name != currentShortcut) {
+        overwrite = tr("A shortcut named '%1' already exists. Do you want to overwrite it?").arg(name);
+    }
+    if (!overwrite.isEmpty()) {
         QMessageBox::StandardButton reply = QMessageBox::question(
             this,
             tr("Overwrite Shortcut"),
-            tr("A shortcut named '%1' already exists. Do you want to overwrite it?").arg(name),
+            overwrite,
             QMessageBox::Yes | QMessageBox::No,
             QMessageBox::No
         );
@@ -424,139 +488,57 @@ void MainWindow::onSaveClicked()
         }
     }
     
-    // Check if the directory exists and is writable
-    QDir dir(SHORTCUT_DIR);
-    if (!dir.exists()) {
-        QMessageBox::critical(this, tr("Error"), 
-            tr("The shortcuts directory does not exist. Please create %1 and ensure it's writable.")
-            .arg(SHORTCUT_DIR));
-        return;
-    }
-    
-    // Check if we have write permission
-    QFileInfo dirInfo(SHORTCUT_DIR);
-    if (!dirInfo.isWritable()) {
-        // Try to use pkexec to gain root privileges
-        QProcess process;
-        QStringList args;
-        args << "--disable-internal-agent" << "--user" << "root" << "--" << "/bin/sh" << "-c" 
-             << QString("mkdir -p %1 && chmod 755 %1").arg(SHORTCUT_DIR);
+    // Functions are compiled into the sourced library instead of separate scripts
+    if (outputMode == OutputMode::Functions) {
+        Shortcut shortcut;
+        shortcut.name = name.toStdString();
+        shortcut.command = command.toStdString();
+        shortcut.options = commandOptions;
         
-        process.start("pkexec", args);
-        if (!process.waitForFinished(5000)) {
+        std::string error;
+        if (!functionLibrary.upsert(shortcut, &error)) {
             QMessageBox::critical(this, tr("Error"), 
-                tr("Failed to create or set permissions on the shortcuts directory.\n"
-                   "Please ensure you have the necessary permissions to write to %1.")
-                .arg(SHORTCUT_DIR));
+                tr("Failed to save shortcut. Error: %1").arg(QString::fromStdString(error)));
             return;
         }
-    }
-    
-    // Create the script content with header comments
-    QString scriptContent = "#!/bin/bash\n";
-    scriptContent += "# Shortcut created with Shorts -- Shortcut Manager Gui\n";
-    scriptContent += "# Created by 0hex01 (Michael McClure)\n";
-    scriptContent += "# Feel free to copy, manipulate, and distribute Shorts and shortcuts created with shorts\n";
-    scriptContent += "# This shortcut comes with no Guarantees or Warranties, use at your own risk\n";
-    scriptContent += "# shortcut command is below this line\n\n";
-    
-    // Add nohup if background mode is enabled
-    if (commandOptions.runInBackground) {
-        scriptContent += "nohup ";
-    }
-    
-    // Check if command already contains sudo
-    bool hasSudo = command.contains("sudo ");
-    
-    // Only add sudo if the checkbox is checked and the command doesn't already have sudo
-    if (commandOptions.useSudo && !hasSudo) {
-        scriptContent += "sudo ";
-    }
-    
-    // Add the command exactly as entered
-    scriptContent += command;
-    
-    if (commandOptions.openEnded) {
-        scriptContent += " \$@";
-    }
-    
-    if (commandOptions.runInBackground) {
-        scriptContent += " &";
-    }
-    
-    scriptContent += "\n";
-    
-    // Create a temporary file in /tmp with a random name
-    QString tempPath = QString("/tmp/shortcut_%1.sh").arg(QUuid::createUuid().toString(QUuid::WithoutBraces));
-    QFile tempFile(tempPath);
-    
-    if (!tempFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::critical(this, tr("Error"), 
-            tr("Failed to create temporary file: %1").arg(tempFile.errorString()));
+        
+        showStatusMessage(tr("Shortcut '%1' saved to %2; new shells pick it up automatically")
+                          .arg(name, QString::fromStdString(functionLibrary.path())));
+        refreshShortcuts();
+        clearFields();
         return;
     }
     
-    // Write the script content to the temporary file
-    QTextStream out(&tempFile);
-    out << scriptContent;
-    tempFile.close();
-    
-    // Set executable permissions on the temp file
-    tempFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner | 
-                           QFile::ReadGroup | QFile::ExeGroup | 
-                           QFile::ReadOther | QFile::ExeOther);
-    
-    // Create the target directory if it doesn't exist
-    QDir().mkpath(SHORTCUT_DIR);
-    
-    // Use pkexec to copy the file with root privileges
-    QProcess process;
-    
-    // Create a shell script to perform the copy and chmod
-    QString scriptPath = "/tmp/shortcut_install_" + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".sh";
-    QFile scriptFile(scriptPath);
-    if (!scriptFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    // Check if the directory exists
+    if (!store->available()) {
         QMessageBox::critical(this, tr("Error"), 
-            tr("Failed to create installation script."));
-        tempFile.remove();
+            tr("The shortcuts directory does not exist. Please create %1 and ensure it's writable.")
+            .arg(QString::fromStdString(store->location())));
         return;
     }
     
-    scriptFile.write(QString("#!/bin/bash\n").toUtf8());
-    scriptFile.write(QString("cp -f \"%1\" \"%2\" && chmod 755 \"%2\"\n").arg(tempPath).arg(shortcutPath).toUtf8());
-    scriptFile.close();
-    
-    // Make the script executable
-    scriptFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner | 
-                             QFile::ReadGroup | QFile::ExeGroup | 
-                             QFile::ReadOther | QFile::ExeOther);
-    
-    // Run the script with pkexec
-    process.start("pkexec", {"--disable-internal-agent", scriptPath});
-    
-    // Wait for the process to finish with a longer timeout
-    if (!process.waitForFinished(10000)) { // 10 second timeout
+    // Generate the script, plus any callers that inline it, and hand them to the
+    // store as one batch, which escalates through pkexec only when the directory
+    // is not writable
+    Shortcut shortcut;
+    shortcut.name = name.toStdString();
+    shortcut.command = ScriptGenerator::commandLine(command.toStdString(), commandOptions);
+    shortcut.options = commandOptions;
+    std::vector<ShortcutStore::Operation> operations = scriptOperations({shortcut});
+    
+    std::string error;
+    if (!applyScriptOperations(operations, &error)) {
         QMessageBox::critical(this, tr("Error"), 
-            tr("Timeout while trying to save shortcut with root privileges."));
-        tempFile.remove();
-        scriptFile.remove();
+            tr("Failed to save shortcut. Error: %1").arg(QString::fromStdString(error)));
         return;
     }
     
-    // Clean up the script file
-    scriptFile.remove();
-    
-    // Clean up the temp file
-    tempFile.remove();
-    
-    if (process.exitCode() != 0) {
-        QString errorOutput = process.readAllStandardError();
-        QMessageBox::critical(this, tr("Error"), 
-            tr("Failed to save shortcut. Error: %1").arg(errorOutput));
-        return;
+    if (operations.size() > 1) {
+        showStatusMessage(tr("Shortcut '%1' saved; %n caller(s) regenerated", nullptr,
+                             static_cast<int>(operations.size() - 1)).arg(name));
+    } else {
+        showStatusMessage(tr("Shortcut '%1' saved successfully!").arg(name));
     }
-    
-    showStatusMessage(tr("Shortcut '%1' saved successfully!").arg(name));
     refreshShortcuts();
     clearFields();
 }
@@ -572,11 +554,57 @@ void MainWindow::onClearClicked()
     showStatusMessage(tr("Form cleared"));
 }
 
+void MainWindow::recordHistory(const QString &name, const std::string &content)
+{
+    if (!history.isOpen()) {
+        return;
+    }
+    
+    std::string error;
+    if (!history.append(name.toStdString(), content, &error)) {
+        qWarning() << "Failed to record history for" << name << ":" << QString::fromStdString(error);
+    }
+}
+
+void MainWindow::onHistoryClicked()
+{
+    if (currentShortcut.isEmpty()) {
+        return;
+    }
+    
+    HistoryDialog dialog(history, currentShortcut, this);
+    if (dialog.exec() != QDialog::Accepted || dialog.selectedVersion() < 0) {
+        return;
+    }
+    
+    // Restoring writes the old command back, regenerating callers that inline it,
+    // and records it as the newest version
+    QString name = currentShortcut;
+    Shortcut restored;
+    restored.name = name.toStdString();
+    restored.command = ShortcutParser::commandLine(dialog.selectedContent().toStdString());
+    std::string error;
+    if (!applyScriptOperations(scriptOperations({restored}), &error)) {
+        QMessageBox::critical(this, tr("Error"), 
+            tr("Failed to restore shortcut. Error: %1").arg(QString::fromStdString(error)));
+        return;
+    }
+    
+    loadShortcut(name);
+    showStatusMessage(tr("Restored version %1 of '%2'").arg(dialog.selectedVersion()).arg(name));
+}
+
 void MainWindow::onDeleteClicked()
 {
     if (currentShortcut.isEmpty()) {
         return;
     }
+    
+    // Several selected shortcuts are deleted together
+    if (ui->shortcutList->selectedItems().size() > 1) {
+        onBulkDelete();
+        return;
+    }
 
     // Create a confirmation dialog
     QMessageBox::StandardButton reply;
@@ -584,12 +612,29 @@ void MainWindow::onDeleteClicked()
                                 tr("Are you sure you want to delete the shortcut '%1'?").arg(currentShortcut),
                                 QMessageBox::Yes | QMessageBox::No);
 
-    if (reply == QMessageBox::Yes) {
-        QString shortcutPath = QString("%1/%2").arg(SHORTCUT_DIR, currentShortcut);
-        QFile file(shortcutPath);
-        
-        if (file.exists()) {
-            if (QFile::remove(shortcutPath)) {
+    if (reply == QMessageBox::Yes && outputMode == OutputMode::Functions) {
+        std::string error;
+        if (functionLibrary.remove(currentShortcut.toStdString(), &error)) {
+            showStatusMessage(tr("Shortcut '%1' deleted").arg(currentShortcut));
+            refreshShortcuts();
+            clearFields();
+        } else {
+            QMessageBox::critical(this, tr("Error"), 
+                                tr("Failed to delete shortcut '%1'. Error: %2")
+                                .arg(currentShortcut, QString::fromStdString(error)));
+        }
+    } else if (reply == QMessageBox::Yes) {
+        if (store->exists(currentShortcut.toStdString())) {
+            // Keep the last version so a deleted shortcut can be brought back
+            std::string lastContent;
+            if (store->read(currentShortcut.toStdString(), lastContent)) {
+                recordHistory(currentShortcut, lastContent);
+            }
+            
+            std::string error;
+            if (store->remove(currentShortcut.toStdString(), &error)) {
+                prefetcher.invalidate(currentShortcut.toStdString());
+                graph.remove(currentShortcut.toStdString());
                 showStatusMessage(tr("Shortcut '%1' deleted").arg(currentShortcut));
                 refreshShortcuts();
                 clearFields();
@@ -611,144 +656,774 @@ void MainWindow::onShortcutSelected(QListWidgetItem *item)
 {
     if (item) {
         loadShortcut(item->text());
+        prefetchNeighbours();
     }
 }
 
+void MainWindow::prefetchNeighbours()
+{
+    QListWidget *list = ui->shortcutList;
+    if (outputMode != OutputMode::Scripts || list->count() == 0) {
+        return;
+    }
+    
+    std::vector<std::string> names;
+    auto add = [&](int row) {
+        if (row >= 0 && row < list->count() && isEditable(list->item(row)->text())) {
+            names.push_back(list->item(row)->text().toStdString());
+        }
+    };
+    
+    // Nearest neighbours of the selection first, alternating down and up
+    const int current = list->currentRow();
+    for (int distance = 1; distance <= 4; ++distance) {
+        add(current + distance);
+        add(current - distance);
+    }
+    
+    // Then the rows visible in the viewport
+    QRect viewport = list->viewport()->rect();
+    int first = list->indexAt(viewport.topLeft()).row();
+    int last = list->indexAt(viewport.bottomLeft()).row();
+    if (first >= 0) {
+        if (last < 0) {
+            last = list->count() - 1;
+        }
+        for (int row = first; row <= last; ++row) {
+            add(row);
+        }
+    }
+    
+    prefetcher.prefetch(names);
+}
+
 void MainWindow::onSudoToggled(bool checked)
 {
     commandOptions.useSudo = checked;
     updateCommandPreview();
 }
 
-void MainWindow::refreshShortcuts()
+bool MainWindow::setResident(bool resident)
 {
-    QDir dir(SHORTCUT_DIR);
-    if (!dir.exists()) {
-        showStatusMessage(tr("Shortcuts directory does not exist: %1").arg(SHORTCUT_DIR));
+    if (!resident) {
+        delete trayIcon;
+        trayIcon = nullptr;
+        return true;
+    }
+    if (trayIcon) {
+        return true;
+    }
+    if (!QSystemTrayIcon::isSystemTrayAvailable()) {
+        return false;
+    }
+    
+    trayIcon = new QSystemTrayIcon(windowIcon(), this);
+    trayIcon->setToolTip(tr("Shorts"));
+    
+    QMenu *menu = new QMenu(this);
+    menu->addAction(tr("Show Shorts"), this, &MainWindow::activate);
+    menu->addAction(tr("Quit"), qApp, &QCoreApplication::quit);
+    trayIcon->setContextMenu(menu);
+    
+    connect(trayIcon, &QSystemTrayIcon::activated, this, [this](QSystemTrayIcon::ActivationReason reason) {
+        if (reason == QSystemTrayIcon::Trigger) {
+            if (isVisible()) {
+                hide();
+            } else {
+                activate();
+            }
+        }
+    });
+    trayIcon->show();
+    return true;
+}
+
+void MainWindow::activate()
+{
+    TRACE_SCOPE("MainWindow::activate");
+    if (sourceVersion() != scannedVersion) {
+        graphLoaded = false;
+        refreshShortcuts();
+    }
+    
+    show();
+    setWindowState(windowState() & ~Qt::WindowMinimized);
+    raise();
+    activateWindow();
+}
+
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    // Without a tray icon there would be no way back, so only hide when one is shown
+    if (trayIcon) {
+        hide();
+        event->ignore();
         return;
     }
+    QMainWindow::closeEvent(event);
+}
+
+quint64 MainWindow::sourceVersion() const
+{
+    // The store tracks its own changes; the function library is a single file
+    if (outputMode == OutputMode::Functions) {
+        return QFileInfo(QString::fromStdString(functionLibrary.path())).lastModified().toMSecsSinceEpoch();
+    }
+    return store->version();
+}
+
+void MainWindow::ensureGraph()
+{
+    if (graphLoaded) {
+        return;
+    }
+    TRACE_SCOPE("MainWindow::ensureGraph");
+    
+    // Only scripts Shorts generated take part: those are the ones it may
+    // regenerate. Everything else is skipped on its header alone.
+    std::vector<Shortcut> shortcuts;
+    for (const ShortcutStore::Entry &entry : store->entries()) {
+        std::string content;
+        if (entry.info.kind != FileClassifier::Kind::Shortcut || !store->read(entry.name, content)) {
+            continue;
+        }
+        Shortcut shortcut;
+        shortcut.name = entry.name;
+        shortcut.command = ShortcutParser::commandLine(content);
+        shortcuts.push_back(shortcut);
+    }
     
-    ui->shortcutList->clear();
-    QFileInfoList files = dir.entryInfoList(QDir::Files | QDir::Executable | QDir::NoDotAndDotDot);
+    graph.build(shortcuts, store->directory());
+    graphLoaded = true;
+}
+
+void MainWindow::updateChainLabel()
+{
+    if (outputMode != OutputMode::Scripts || currentShortcut.isEmpty()) {
+        ui->chainLabel->clear();
+        return;
+    }
+    
+    ensureGraph();
+    const std::string name = currentShortcut.toStdString();
+    if (!graph.contains(name)) {
+        ui->chainLabel->setText(tr("Not a Shorts script"));
+        return;
+    }
     
-    for (const QFileInfo &file : files) {
-        if (!file.fileName().startsWith('.')) {
-            ui->shortcutList->addItem(file.fileName());
+    auto joined = [](const std::vector<std::string> &names, const QString &separator) {
+        QStringList list;
+        for (const std::string &entry : names) {
+            list << QString::fromStdString(entry);
+        }
+        return list.join(separator);
+    };
+    
+    QStringList parts;
+    for (const std::vector<std::string> &cycle : graph.cycles()) {
+        if (std::find(cycle.begin(), cycle.end(), name) != cycle.end()) {
+            parts << tr("Cycle between %1; never inlined").arg(joined(cycle, ", "));
         }
     }
     
-    ui->shortcutList->sortItems();
+    std::vector<std::string> chain = graph.longestChain(name);
+    if (chain.size() > 1) {
+        parts << joined(chain, QString::fromUtf8(" \u2192 "));
+    }
     
-    if (ui->shortcutList->count() > 0) {
-        ui->shortcutList->setCurrentRow(0);
-        loadShortcut(ui->shortcutList->currentItem()->text());
+    std::vector<std::string> callers = graph.callers(name);
+    if (!callers.empty()) {
+        parts << tr("called by %1").arg(joined(callers, ", "));
     }
+    
+    if (flattenChains && chain.size() > 1 && ShortcutGraph::isTriviallyForwarding(graph.flatten(name))) {
+        parts << tr("runs as one process");
+    }
+    
+    ui->chainLabel->setText(parts.isEmpty() ? tr("Calls no other shortcut") : parts.join("; "));
 }
 
-void MainWindow::onOpenEndedToggled(bool checked)
+std::vector<ShortcutStore::Operation> MainWindow::scriptOperations(const std::vector<Shortcut> &shortcuts)
 {
-    commandOptions.openEnded = checked;
-    updateCommandPreview();
+    TRACE_SCOPE("MainWindow::scriptOperations");
+    ensureGraph();
+    for (const Shortcut &shortcut : shortcuts) {
+        graph.insert(shortcut);
+    }
+    
+    std::vector<ShortcutStore::Operation> operations;
+    std::set<std::string> written;
+    for (const Shortcut &shortcut : shortcuts) {
+        ShortcutStore::Operation operation;
+        operation.name = shortcut.name;
+        operation.content = graph.script(shortcut.name, flattenChains);
+        operations.push_back(operation);
+        written.insert(shortcut.name);
+    }
+    
+    // Callers that inline a changed shortcut carry a stale copy of it. A deleted
+    // callee is left inlined: regenerating would only make its callers fail.
+    if (flattenChains) {
+        for (const Shortcut &shortcut : shortcuts) {
+            for (const std::string &dependent : graph.dependents(shortcut.name)) {
+                std::string current;
+                ShortcutStore::Operation operation;
+                operation.name = dependent;
+                operation.content = graph.script(dependent, true);
+                if (written.insert(dependent).second
+                    && (!store->read(dependent, current) || current != operation.content)) {
+                    operations.push_back(operation);
+                }
+            }
+        }
+    }
+    return operations;
 }
 
-void MainWindow::updateCommandPreview()
+bool MainWindow::applyScriptOperations(const std::vector<ShortcutStore::Operation> &operations,
+                                       std::string *error)
 {
-    QString command = ui->commandEdit->text().trimmed();
+    // Keep what is about to be overwritten or deleted in the history
+    for (const ShortcutStore::Operation &operation : operations) {
+        std::string previousContent;
+        QString name = QString::fromStdString(operation.name);
+        if ((operation.type == ShortcutStore::Operation::Remove || history.versions(operation.name).empty())
+            && store->read(operation.name, previousContent)) {
+            recordHistory(name, previousContent);
+        }
+    }
     
-    if (command.isEmpty()) {
-        ui->previewEdit->clear();
+    bool ok = store->applyBatch(operations, error);
+    for (const ShortcutStore::Operation &operation : operations) {
+        prefetcher.invalidate(operation.name);
+        if (ok && operation.type == ShortcutStore::Operation::Write) {
+            recordHistory(QString::fromStdString(operation.name), operation.content);
+        }
+    }
+    
+    // The graph was updated ahead of the write; read it again from disk
+    if (!ok) {
+        graphLoaded = false;
+    }
+    return ok;
+}
+
+void MainWindow::onFlattenToggled(bool checked)
+{
+    flattenChains = checked;
+    QSettings settings("0hex01", "Shorts");
+    settings.setValue("flattenChains", checked);
+    
+    // Bring every generated script in line with the new mode in one batch
+    ensureGraph();
+    std::vector<ShortcutStore::Operation> operations;
+    for (const std::string &name : graph.names()) {
+        std::string current;
+        ShortcutStore::Operation operation;
+        operation.name = name;
+        operation.content = graph.script(name, checked);
+        if (store->read(name, current) && current != operation.content) {
+            operations.push_back(operation);
+        }
+    }
+    
+    if (!operations.empty()) {
+        QMessageBox::StandardButton reply = QMessageBox::question(
+            this, tr("Regenerate Shortcuts"),
+            tr("Regenerate %n shortcut(s) that call other shortcuts now?", nullptr,
+               static_cast<int>(operations.size())),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+        
+        std::string error;
+        if (reply == QMessageBox::Yes && !applyScriptOperations(operations, &error)) {
+            QMessageBox::critical(this, tr("Error"), 
+                tr("Failed to regenerate shortcuts. Error: %1").arg(QString::fromStdString(error)));
+        }
+    }
+    updateChainLabel();
+}
+
+void MainWindow::onCheckAllClicked()
+{
+    if (healthThread.joinable()) {
         return;
     }
+    if (!healthCheck) {
+        healthCheck = std::make_unique<HealthCheck>();
+    }
     
-    // Check if command starts with sudo
-    bool startsWithSudo = command.startsWith("sudo ");
+    // Only Shorts shortcuts: foreign binaries have no command line to check
+    std::vector<std::string> names;
+    std::vector<Shortcut> functions;
+    if (outputMode == OutputMode::Functions) {
+        for (const std::string &name : functionLibrary.list()) {
+            Shortcut shortcut;
+            if (functionLibrary.get(name, shortcut)) {
+                shortcut.name = name;
+                functions.push_back(shortcut);
+            }
+        }
+    } else {
+        for (auto it = entryInfo.constBegin(); it != entryInfo.constEnd(); ++it) {
+            if (it->kind == FileClassifier::Kind::Shortcut) {
+                names.push_back(it.key().toStdString());
+            }
+        }
+    }
     
-    // If command starts with sudo, make sure the checkbox is checked
-    if (startsWithSudo) {
-        ui->sudoCheckBox->setChecked(true);
-        command = command.mid(5).trimmed(); // Remove sudo from the command
+    const int total = static_cast<int>(names.size() + functions.size());
+    ui->checkAllButton->setEnabled(false);
+    showStatusMessage(tr("Checking %n shortcut(s)...", nullptr, total), 0);
+    
+    // The GUI thread only hears about progress and the final report
+    healthCancel = false;
+    healthThread = std::thread([this, names, functions]() {
+        Trace::setThreadName("health check");
+        auto progress = [this](size_t done, size_t total) {
+            if (done % 500 == 0) {
+                QMetaObject::invokeMethod(this, [this, done, total]() {
+                    showStatusMessage(tr("Checked %1 of %2 shortcuts...").arg(done).arg(total), 0);
+                }, Qt::QueuedConnection);
+            }
+        };
+        HealthCheck::Report report = functions.empty()
+            ? healthCheck->run(store, names, HealthCheck::DEFAULT_TIMEOUT_MS, progress, &healthCancel)
+            : healthCheck->run(functions, HealthCheck::DEFAULT_TIMEOUT_MS, progress, &healthCancel);
+        QMetaObject::invokeMethod(this, [this, report]() { onHealthCheckFinished(report); },
+                                  Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::onHealthCheckFinished(const HealthCheck::Report &report)
+{
+    healthThread.join();
+    ui->checkAllButton->setEnabled(true);
+    if (report.cancelled) {
+        return;
     }
     
-    QString preview;
+    showStatusMessage(tr("Health check: %n problem(s) found", nullptr, static_cast<int>(report.findings.size())));
     
-    // Add sudo if the checkbox is checked
-    if (ui->sudoCheckBox->isChecked()) {
-        preview += "sudo ";
+    HealthDialog *dialog = new HealthDialog(report, this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dialog, &HealthDialog::shortcutActivated, this, [this](const QString &name) {
+        QList<QListWidgetItem *> items = ui->shortcutList->findItems(name, Qt::MatchExactly);
+        if (!items.isEmpty()) {
+            items.first()->setHidden(false);
+            ui->shortcutList->setCurrentItem(items.first());
+            activate();
+        }
+    });
+    dialog->show();
+}
+
+void MainWindow::setupBulkMenu()
+{
+    QMenu *menu = new QMenu(ui->bulkButton);
+    menu->addAction(tr("Delete selected"), this, &MainWindow::onBulkDelete);
+    menu->addSeparator();
+    menu->addAction(tr("Toggle sudo"), this, [this]() { onBulkToggle(BulkEdit::Flag::Sudo); });
+    menu->addAction(tr("Toggle run in background"), this, [this]() { onBulkToggle(BulkEdit::Flag::Background); });
+    menu->addAction(tr("Toggle open ended"), this, [this]() { onBulkToggle(BulkEdit::Flag::OpenEnded); });
+    menu->addSeparator();
+    menu->addAction(tr("Find and replace in commands..."), this, &MainWindow::onBulkReplace);
+    ui->bulkButton->setMenu(menu);
+}
+
+QStringList MainWindow::selectedShortcutNames() const
+{
+    QStringList names;
+    for (QListWidgetItem *item : ui->shortcutList->selectedItems()) {
+        if (isEditable(item->text())) {
+            names << item->text();
+        }
+    }
+    names.sort();
+    return names;
+}
+
+bool MainWindow::getShortcut(const QString &name, Shortcut &shortcut)
+{
+    if (outputMode == OutputMode::Functions) {
+        return functionLibrary.get(name.toStdString(), shortcut);
+    }
+    return prefetcher.get(name.toStdString(), shortcut);
+}
+
+void MainWindow::onBulkDelete()
+{
+    std::vector<std::string> removed;
+    for (const QString &name : selectedShortcutNames()) {
+        removed.push_back(name.toStdString());
+    }
+    applyBulk(tr("Delete"), {}, removed);
+}
+
+void MainWindow::onBulkToggle(BulkEdit::Flag flag)
+{
+    std::vector<Shortcut> shortcuts;
+    for (const QString &name : selectedShortcutNames()) {
+        Shortcut shortcut;
+        if (getShortcut(name, shortcut)) {
+            shortcut.name = name.toStdString();
+            shortcuts.push_back(shortcut);
+        }
     }
     
-    // Add nohup if running in background
-    if (ui->backgroundCheckBox->isChecked()) {
-        preview += "nohup ";
+    // Turn the option on everywhere unless every selected shortcut already has it
+    bool allHaveIt = !shortcuts.empty();
+    for (const Shortcut &shortcut : shortcuts) {
+        allHaveIt = allHaveIt && BulkEdit::hasFlag(shortcut, flag);
     }
     
-    // Add the command (without sudo)
-    preview += command;
+    std::vector<Shortcut> updated;
+    for (const Shortcut &shortcut : shortcuts) {
+        updated.push_back(BulkEdit::withFlag(shortcut, flag, !allHaveIt));
+    }
     
-    // Add $@ if open-ended
-    if (ui->openEndedCheckBox->isChecked()) {
-        preview += " $@";
+    static const char *const flagNames[] = {"sudo", "run in background", "open ended"};
+    applyBulk(tr("Turn %1 %2").arg(flagNames[static_cast<int>(flag)], allHaveIt ? tr("off") : tr("on")),
+              updated, {});
+}
+
+void MainWindow::onBulkReplace()
+{
+    bool ok = false;
+    QString find = QInputDialog::getText(this, tr("Find and Replace"), tr("Find in commands:"),
+                                         QLineEdit::Normal, QString(), &ok);
+    if (!ok || find.isEmpty()) {
+        return;
+    }
+    QString replacement = QInputDialog::getText(this, tr("Find and Replace"),
+                                                tr("Replace '%1' with:").arg(find),
+                                                QLineEdit::Normal, QString(), &ok);
+    if (!ok) {
+        return;
     }
     
-    // Add & if running in background
-    if (ui->backgroundCheckBox->isChecked()) {
-        preview += " &";
+    std::vector<Shortcut> updated;
+    for (const QString &name : selectedShortcutNames()) {
+        Shortcut shortcut;
+        if (getShortcut(name, shortcut) && shortcut.command.find(find.toStdString()) != std::string::npos) {
+            shortcut.name = name.toStdString();
+            updated.push_back(BulkEdit::withReplacement(shortcut, find.toStdString(), replacement.toStdString()));
+        }
     }
     
-    // Update the preview
-    ui->previewEdit->setText(preview);
+    applyBulk(tr("Replace '%1' with '%2' in").arg(find, replacement), updated, {});
 }
 
-void MainWindow::loadShortcut(const QString &name)
+void MainWindow::applyBulk(const QString &action, const std::vector<Shortcut> &updated,
+                           const std::vector<std::string> &removed)
 {
-    if (name.isEmpty()) {
+    TRACE_SCOPE("MainWindow::applyBulk");
+    const int count = static_cast<int>(updated.size() + removed.size());
+    if (count == 0) {
+        showStatusMessage(tr("Nothing to change"));
         return;
     }
     
-    QString shortcutPath = QString("%1/%2").arg(SHORTCUT_DIR, name);
-    QFile file(shortcutPath);
+    // Preview every change once, then apply them all together
+    QStringList details;
+    for (const Shortcut &shortcut : updated) {
+        details << QString("%1: %2").arg(QString::fromStdString(shortcut.name),
+            QString::fromStdString(ScriptGenerator::commandLine(shortcut.command, shortcut.options)));
+    }
+    for (const std::string &name : removed) {
+        details << tr("%1: deleted").arg(QString::fromStdString(name));
+    }
     
-    if (!file.exists()) {
-        showStatusMessage(tr("Shortcut not found: %1").arg(name));
+    QMessageBox preview(QMessageBox::Question, tr("Bulk Change"),
+                        tr("%1 %n shortcut(s)?", nullptr, count).arg(action),
+                        QMessageBox::Yes | QMessageBox::No, this);
+    preview.setDefaultButton(QMessageBox::No);
+    preview.setDetailedText(details.join('\n'));
+    if (preview.exec() != QMessageBox::Yes) {
+        showStatusMessage(tr("Bulk change cancelled"));
         return;
     }
     
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        showStatusMessage(tr("Cannot open shortcut: %1").arg(name));
+    std::string error;
+    bool ok;
+    if (outputMode == OutputMode::Functions) {
+        // One rewrite of the library covers the whole batch
+        ok = functionLibrary.update(updated, removed, &error);
+    } else {
+        std::vector<Shortcut> lines;
+        for (const Shortcut &shortcut : updated) {
+            Shortcut line = shortcut;
+            line.command = ScriptGenerator::commandLine(shortcut.command, shortcut.options);
+            lines.push_back(line);
+        }
+        std::vector<ShortcutStore::Operation> operations = scriptOperations(lines);
+        for (const std::string &name : removed) {
+            ShortcutStore::Operation operation;
+            operation.type = ShortcutStore::Operation::Remove;
+            operation.name = name;
+            operations.push_back(operation);
+        }
+        ok = applyScriptOperations(operations, &error);
+    }
+    
+    if (!ok) {
+        // Staging failures change nothing, but one while renaming or deleting,
+        // or inside the privileged helper, leaves the batch partly applied;
+        // show what is actually there now
+        QMessageBox::critical(this, tr("Error"), 
+            tr("Bulk change failed; some shortcuts may have been changed. Error: %1")
+                .arg(QString::fromStdString(error)));
+        refreshShortcuts();
         return;
     }
     
-    // Read the file content
-    QTextStream in(&file);
-    QString content = in.readAll();
-    file.close();
+    // Update the list and everything cached about it in place instead of rescanning
+    QSet<QString> removedNames;
+    for (const std::string &name : removed) {
+        removedNames.insert(QString::fromStdString(name));
+        entryInfo.remove(QString::fromStdString(name));
+        if (outputMode == OutputMode::Scripts) {
+            graph.remove(name);
+            prefetcher.invalidate(name);
+        }
+    }
+    {
+        QSignalBlocker blocker(ui->shortcutList);
+        for (int row = ui->shortcutList->count() - 1; row >= 0; --row) {
+            if (removedNames.contains(ui->shortcutList->item(row)->text())) {
+                delete ui->shortcutList->takeItem(row);
+            }
+        }
+    }
     
-    // Set the current shortcut
-    currentShortcut = name;
+    if (removedNames.contains(currentShortcut)) {
+        clearFields();
+    } else if (!currentShortcut.isEmpty()) {
+        loadShortcut(currentShortcut);
+    }
     
-    // Update UI
-    ui->nameEdit->setText(name);
+    showStatusMessage(tr("%1 %n shortcut(s): done", nullptr, count).arg(action));
+}
+
+bool MainWindow::shortcutExists(const QString &name) const
+{
+    if (outputMode == OutputMode::Functions) {
+        return functionLibrary.contains(name.toStdString());
+    }
+    return store->exists(name.toStdString());
+}
+
+void MainWindow::onOutputModeChanged(int index)
+{
+    outputMode = index == 1 ? OutputMode::Functions : OutputMode::Scripts;
+    ui->flattenCheckBox->setEnabled(outputMode == OutputMode::Scripts);
     
-    // Parse the command (get the last non-empty, non-comment line)
-    QStringList lines = content.split('\n', Qt::SkipEmptyParts);
-    QString command;
+    QSettings settings("0hex01", "Shorts");
+    settings.setValue("outputMode", outputMode == OutputMode::Functions ? "functions" : "scripts");
     
-    for (int i = lines.size() - 1; i >= 0; --i) {
-        QString line = lines[i].trimmed();
-        if (!line.isEmpty() && !line.startsWith('#')) {
-            command = line;
-            break;
+    clearFields();
+    refreshShortcuts();
+}
+
+void MainWindow::refreshShortcuts()
+{
+    TRACE_SCOPE("MainWindow::refreshShortcuts");
+    // Anything parsed before the shortcuts changed may be stale, whoever changed
+    // them; bulk edits would otherwise write old commands back
+    const quint64 version = sourceVersion();
+    if (version != scannedVersion) {
+        prefetcher.clear();
+    }
+    scannedVersion = version;
+    if (outputMode == OutputMode::Functions) {
+        std::string error;
+        if (!functionLibrary.load(&error)) {
+            showStatusMessage(tr("Cannot read %1: %2")
+                              .arg(QString::fromStdString(functionLibrary.path()),
+                                   QString::fromStdString(error)));
+        }
+        
+        ui->shortcutList->clear();
+        entryInfo.clear();
+        for (const std::string &name : functionLibrary.list()) {
+            ui->shortcutList->addItem(QString::fromStdString(name));
         }
+        
+        if (ui->shortcutList->count() > 0) {
+            ui->shortcutList->setCurrentRow(0);
+        }
+        return;
+    }
+    
+    if (!store->available()) {
+        showStatusMessage(tr("Shortcuts directory does not exist: %1")
+                          .arg(QString::fromStdString(store->location())));
+        return;
+    }
+    
+    ui->shortcutList->clear();
+    entryInfo.clear();
+    
+    // The store already skips hidden files and returns the names sorted; each
+    // entry is classified from its first bytes, never read in full
+    for (const ShortcutStore::Entry &entry : store->entries()) {
+        QString name = QString::fromStdString(entry.name);
+        entryInfo.insert(name, entry.info);
+        
+        QListWidgetItem *item = new QListWidgetItem(name, ui->shortcutList);
+        if (entry.info.kind != FileClassifier::Kind::Shortcut) {
+            item->setForeground(QColor("#808080"));
+            item->setToolTip(describeEntry(entry.info));
+        }
+        if (!isEditable(name)) {
+            QFont font = item->font();
+            font.setItalic(true);
+            item->setFont(font);
+        }
+    }
+    
+    applyListFilter();
+}
+
+void MainWindow::applyListFilter()
+{
+    const bool managedOnly = ui->managedOnlyCheckBox->isChecked() && outputMode == OutputMode::Scripts;
+    for (int row = 0; row < ui->shortcutList->count(); ++row) {
+        QListWidgetItem *item = ui->shortcutList->item(row);
+        auto info = entryInfo.constFind(item->text());
+        item->setHidden(managedOnly && info != entryInfo.constEnd()
+                        && info->kind != FileClassifier::Kind::Shortcut);
     }
     
-    // Remove shebang if present
-    if (command.startsWith("#!")) {
-        command = command.section(' ', 1);
+    // Selecting the first visible row loads it through currentItemChanged
+    QListWidgetItem *current = ui->shortcutList->currentItem();
+    if (current && !current->isHidden()) {
+        return;
+    }
+    for (int row = 0; row < ui->shortcutList->count(); ++row) {
+        if (!ui->shortcutList->item(row)->isHidden()) {
+            ui->shortcutList->setCurrentRow(row);
+            return;
+        }
+    }
+}
+
+// What name is, from the last scan or, for files that appeared since, from the
+// store; false if there is no such file
+bool MainWindow::entryInfoFor(const QString &name, FileClassifier::Info &info) const
+{
+    auto cached = entryInfo.constFind(name);
+    if (cached != entryInfo.constEnd()) {
+        info = *cached;
+        return true;
     }
+    return store->inspect(name.toStdString(), info);
+}
+
+bool MainWindow::isEditable(const QString &name) const
+{
+    // Scripts load as before; binaries, and scripts too large to be hand-written,
+    // are only described. A name with no file yet is a new shortcut.
+    FileClassifier::Info info;
+    if (outputMode == OutputMode::Functions || !entryInfoFor(name, info)) {
+        return true;
+    }
+    return info.kind == FileClassifier::Kind::Shortcut
+        || (info.kind == FileClassifier::Kind::Script && info.size <= 1024 * 1024);
+}
+
+QString MainWindow::describeEntry(const FileClassifier::Info &info) const
+{
+    QStringList parts;
+    parts << QString::fromLatin1(FileClassifier::describe(info.kind));
+    if (!info.interpreter.empty()) {
+        parts << QString::fromStdString(info.interpreter);
+    }
+    parts << QLocale().formattedDataSize(static_cast<qint64>(info.size));
+    parts << tr("modified %1").arg(QLocale().toString(
+        QDateTime::fromSecsSinceEpoch(info.modified), QLocale::ShortFormat));
+    return parts.join(QString::fromUtf8(" \u00b7 "));
+}
+
+void MainWindow::showForeignEntry(const QString &name)
+{
+    clearFields();
+    ui->nameEdit->setText(name);
+    FileClassifier::Info info;
+    entryInfoFor(name, info);
+    ui->previewEdit->setText(describeEntry(info));
+    showStatusMessage(tr("'%1' was not created by Shorts and is shown read-only").arg(name));
+}
+
+void MainWindow::onOpenEndedToggled(bool checked)
+{
+    commandOptions.openEnded = checked;
+    updateCommandPreview();
+}
+
+void MainWindow::updateCommandPreview()
+{
+    TRACE_SCOPE("MainWindow::updateCommandPreview");
+    QString command = ui->commandEdit->text().trimmed();
+    
+    if (command.isEmpty()) {
+        ui->previewEdit->clear();
+        return;
+    }
+    
+    // If command starts with sudo, make sure the checkbox is checked
+    if (command.startsWith("sudo ")) {
+        ui->sudoCheckBox->setChecked(true);
+    }
+    
+    CommandOptions options;
+    options.useSudo = ui->sudoCheckBox->isChecked();
+    options.runInBackground = ui->backgroundCheckBox->isChecked();
+    options.openEnded = ui->openEndedCheckBox->isChecked();
+    
+    // Update the preview
+    ui->previewEdit->setText(QString::fromStdString(
+        ScriptGenerator::preview(command.toStdString(), options)));
+}
+
+void MainWindow::loadShortcut(const QString &name)
+{
+    TRACE_SCOPE("MainWindow::loadShortcut");
+    if (name.isEmpty()) {
+        return;
+    }
+    
+    // Foreign binaries are described from their header, never read
+    if (!isEditable(name)) {
+        showForeignEntry(name);
+        return;
+    }
+    
+    // Functions are already parsed in memory; scripts are usually a cache hit
+    // because the neighbours of the previous selection were prefetched
+    Shortcut parsed;
+    if (outputMode == OutputMode::Functions) {
+        if (!functionLibrary.get(name.toStdString(), parsed)) {
+            showStatusMessage(tr("Shortcut not found: %1").arg(name));
+            return;
+        }
+    } else if (!prefetcher.get(name.toStdString(), parsed)) {
+        if (!store->exists(name.toStdString())) {
+            showStatusMessage(tr("Shortcut not found: %1").arg(name));
+        } else {
+            showStatusMessage(tr("Cannot open shortcut: %1").arg(name));
+        }
+        return;
+    }
+    
+    // Set the current shortcut
+    currentShortcut = name;
+    
+    // Update UI
+    ui->nameEdit->setText(name);
     
-    // Parse options without modifying the command
-    commandOptions.useSudo = command.contains("sudo ");
-    commandOptions.runInBackground = command.contains("nohup ") || command.endsWith(" &");
-    commandOptions.openEnded = command.contains("$@") || command.contains("\"$@\"");
+    // The bare command and its options; saving adds the decorations back once
+    QString command = QString::fromStdString(parsed.command);
+    commandOptions = parsed.options;
     
     // Update UI with the original command
     ui->commandEdit->setText(command);
@@ -756,9 +1431,11 @@ void MainWindow::loadShortcut(const QString &name)
     ui->backgroundCheckBox->setChecked(commandOptions.runInBackground);
     ui->openEndedCheckBox->setChecked(commandOptions.openEnded);
     ui->deleteButton->setEnabled(true);
+    ui->historyButton->setEnabled(outputMode == OutputMode::Scripts);
     
     // Update the command preview
     updateCommandPreview();
+    updateChainLabel();
     
     showStatusMessage(tr("Loaded shortcut: %1").arg(name));
 }
@@ -771,6 +1448,8 @@ void MainWindow::clearFields()
     ui->backgroundCheckBox->setChecked(false);
     ui->openEndedCheckBox->setChecked(false);
     ui->deleteButton->setEnabled(false);
+    ui->historyButton->setEnabled(false);
+    ui->chainLabel->clear();
     currentShortcut.clear();
     
     // Reset command options
@@ -1,11 +1,27 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QDateTime>
 #include <QMainWindow>
 #include <QListWidgetItem>
 #include <QString>
 #include <QMap>
 #include <QLineEdit>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "core/bulkedit.h"
+#include "core/fileclassifier.h"
+#include "core/functionlibrary.h"
+#include "core/healthcheck.h"
+#include "core/historypack.h"
+#include "core/prefetcher.h"
+#include "core/shortcut.h"
+#include "core/shortcutgraph.h"
+#include "core/shortcutstore.h"
+
+class QSystemTrayIcon;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -16,18 +32,40 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget *parent = nullptr);
+    // The window takes over the store its shortcuts are kept in
+    explicit MainWindow(std::unique_ptr<ShortcutStore> shortcutStore, QWidget *parent = nullptr);
     ~MainWindow() override;
     
     // Override to ensure consistent window behavior
     QSize sizeHint() const override { return QSize(800, 600); }
+    
+    // Resident mode: closing the window hides it to the tray and the process
+    // stays up, with its list and caches warm, until Quit is chosen. Returns false
+    // if there is no system tray to hide to.
+    bool setResident(bool resident);
+
+public slots:
+    // Show and raise the window, rescanning only if the shortcuts changed on disk
+    void activate();
+
+protected:
+    void closeEvent(QCloseEvent *event) override;
 
 private slots:
     void onBrowseClicked();
     void onSaveClicked();
     void onDeleteClicked();
     void onClearClicked();
+    void onHistoryClicked();
+    void onOutputModeChanged(int index);
+    void onBulkDelete();
+    void onBulkToggle(BulkEdit::Flag flag);
+    void onBulkReplace();
+    void onFlattenToggled(bool checked);
+    void onCheckAllClicked();
+    void applyListFilter();
     void onShortcutSelected(QListWidgetItem *item);
+    void prefetchNeighbours();
     void onSudoToggled(bool checked);
     void onBackgroundToggled(bool checked);
     void onOpenEndedToggled(bool checked);
@@ -43,18 +81,53 @@ private:
     void setupDarkTheme();
     void setupIcons();
     void firstRunSetup();
-    bool isValidShortcutName(const QString &name);
+    void recordHistory(const QString &name, const std::string &content);
+    bool shortcutExists(const QString &name) const;
+    quint64 sourceVersion() const;
+    bool entryInfoFor(const QString &name, FileClassifier::Info &info) const;
+    bool isEditable(const QString &name) const;
+    QString describeEntry(const FileClassifier::Info &info) const;
+    void showForeignEntry(const QString &name);
+    void onHealthCheckFinished(const HealthCheck::Report &report);
+    void setupBulkMenu();
+    QStringList selectedShortcutNames() const;
+    bool getShortcut(const QString &name, Shortcut &shortcut);
+    void applyBulk(const QString &action, const std::vector<Shortcut> &updated,
+                   const std::vector<std::string> &removed);
+    void ensureGraph();
+    void updateChainLabel();
+    std::vector<ShortcutStore::Operation> scriptOperations(const std::vector<Shortcut> &shortcuts);
+    bool applyScriptOperations(const std::vector<ShortcutStore::Operation> &operations, std::string *error);
     
     Ui::MainWindow *ui;
     QString currentShortcut;
+    CommandOptions commandOptions;
+    // Script files in the store, or functions in the sourced library
+    enum class OutputMode { Scripts, Functions };
+    OutputMode outputMode = OutputMode::Scripts;
+    
+    // Shared with health-check tasks, which may outlive a check that timed out
+    std::shared_ptr<ShortcutStore> store;
+    FunctionLibrary functionLibrary;
+    HistoryPack history;
+    Prefetcher prefetcher{*store};
+    
+    // What each listed file is, from its first bytes (script mode only)
+    QMap<QString, FileClassifier::Info> entryInfo;
+    
+    // Calls between script shortcuts, read lazily; inlined into callers when
+    // flattenChains is on
+    ShortcutGraph graph;
+    bool graphLoaded = false;
+    bool flattenChains = false;
     
-    struct CommandOptions {
-        bool useSudo = false;
-        bool runInBackground = false;
-        bool openEnded = false;
-    } commandOptions;
+    // "Check All" runs on its own thread, fanned out over the health check's pool
+    std::unique_ptr<HealthCheck> healthCheck;
+    std::thread healthThread;
+    std::atomic<bool> healthCancel{false};
     
-    static constexpr const char* SHORTCUT_DIR = "/usr/local/bin";
+    QSystemTrayIcon *trayIcon = nullptr;
+    quint64 scannedVersion = 0;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,155 @@
+#include "singleinstance.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "core/trace.h"
+
+namespace {
+
+const char ACTIVATE[] = "show\n";
+const char ACKNOWLEDGE[] = "ok\n";
+
+// The user behind the launch, not root after pkexec/sudo
+uid_t launchingUid()
+{
+    if (geteuid() == 0) {
+        for (const char *variable : {"PKEXEC_UID", "SUDO_UID"}) {
+            bool ok = false;
+            uint uid = qEnvironmentVariable(variable).toUInt(&ok);
+            if (ok) {
+                return static_cast<uid_t>(uid);
+            }
+        }
+    }
+    return getuid();
+}
+
+} // namespace
+
+SingleInstance::SingleInstance(QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &SingleInstance::onNewConnection);
+}
+
+QString SingleInstance::serverName(const QString &storeLocation)
+{
+    // A short digest keeps arbitrary store paths within the socket path limit
+    const QString store = QCryptographicHash::hash(storeLocation.toUtf8(), QCryptographicHash::Sha1)
+                              .toHex().left(12);
+
+    // pkexec and sudo reset the environment, so derive the runtime directory from
+    // the uid rather than XDG_RUNTIME_DIR
+    const uid_t uid = launchingUid();
+    const QString runtimeDir = QString("/run/user/%1").arg(uid);
+    if (QDir(runtimeDir).exists()) {
+        return runtimeDir + QString("/shorts-%1.sock").arg(store);
+    }
+    return QString("/tmp/shorts-%1-%2.sock").arg(uid).arg(store);
+}
+
+bool SingleInstance::activateRunning(const QString &storeLocation, int timeoutMs)
+{
+    TRACE_SCOPE("SingleInstance::activateRunning");
+
+    // Plain POSIX rather than QLocalSocket: this runs before QApplication exists,
+    // and QLocalServer on Unix is an ordinary stream socket
+    const QByteArray path = QFile::encodeName(serverName(storeLocation));
+    struct sockaddr_un address = {};
+    if (path.size() >= static_cast<int>(sizeof(address.sun_path))) {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.constData(), static_cast<size_t>(path.size()));
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    // A stale socket refuses the connection immediately
+    bool ok = ::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0
+              && ::send(fd, ACTIVATE, sizeof(ACTIVATE) - 1, MSG_NOSIGNAL)
+                 == static_cast<ssize_t>(sizeof(ACTIVATE) - 1);
+
+    std::string reply;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (ok && reply.find('\n') == std::string::npos) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            ok = false;
+            break;
+        }
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, static_cast<int>(remaining));
+        if (ready <= 0) {
+            ok = ready < 0 && errno == EINTR;
+            continue;
+        }
+        char buffer[16];
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        ok = n > 0;
+        if (ok) {
+            reply.append(buffer, static_cast<size_t>(n));
+        }
+    }
+    ::close(fd);
+    return ok && reply == ACKNOWLEDGE;
+}
+
+bool SingleInstance::listen(const QString &storeLocation, QString *error)
+{
+    const QString name = serverName(storeLocation);
+
+    // A socket left behind by a crashed instance would make listen() fail
+    QLocalServer::removeServer(name);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(name)) {
+        if (error) {
+            *error = m_server->errorString();
+        }
+        return false;
+    }
+
+    const QByteArray path = QFile::encodeName(m_server->fullServerName());
+    if (::chown(path.constData(), launchingUid(), static_cast<gid_t>(-1)) != 0) {
+        if (error) {
+            *error = tr("Cannot hand %1 to the launching user").arg(m_server->fullServerName());
+        }
+        m_server->close();
+        return false;
+    }
+    return true;
+}
+
+void SingleInstance::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            if (!socket->canReadLine()) {
+                return;
+            }
+            if (socket->readLine() == ACTIVATE) {
+                socket->write(ACKNOWLEDGE);
+                socket->flush();
+                emit activationRequested();
+            }
+            socket->disconnectFromServer();
+        });
+    }
+}
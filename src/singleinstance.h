@@ -0,0 +1,45 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QString>
+
+class QLocalServer;
+
+// Locates a resident Shorts through a local socket. The resident instance listens
+// and is asked to show its window; a later launch only has to connect and say so,
+// which takes a few milliseconds instead of a full start-up. Every store has its
+// own socket, so a launch only ever raises an instance managing the shortcuts it
+// asked for.
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(QObject *parent = nullptr);
+
+    // Socket of the resident instance managing storeLocation for the user who
+    // launched Shorts (the caller of pkexec or sudo when running as root)
+    static QString serverName(const QString &storeLocation);
+
+    // Ask a running instance for the same store to show its window. Safe to call
+    // before the QApplication exists; returns false if nobody answered within
+    // timeoutMs.
+    static bool activateRunning(const QString &storeLocation, int timeoutMs);
+
+    // Become the resident instance for storeLocation. The socket is created
+    // private to root and then handed to the launching user so their later
+    // launches can reach it.
+    bool listen(const QString &storeLocation, QString *error = nullptr);
+
+signals:
+    void activationRequested();
+
+private slots:
+    void onNewConnection();
+
+private:
+    QLocalServer *m_server;
+};
+
+#endif // SINGLEINSTANCE_H